@@ -0,0 +1,57 @@
+//! Benchmarks of finding Steam's processes among the system's, on the machine that runs them.
+//!
+//! Close Steam first: checks then scan every process rather than stopping at Steam's, which is the slow path a
+//! switch takes while waiting for Steam to exit. The benchmarks are skipped where Steam isn't installed.
+//!
+//! ```shell
+//! cargo bench --bench processes
+//! ```
+
+use criterion::{black_box, criterion_group, criterion_main, Criterion};
+use diverter::{Steam, Timings, Tracker};
+
+fn bench_processes(c: &mut Criterion) {
+    let steam = match Steam::new() {
+        Ok(steam) => steam,
+        Err(e) => {
+            eprintln!("skipping the process benchmarks, Steam is unavailable: {e}");
+            return;
+        }
+    };
+    if steam.is_running().unwrap_or(true) {
+        eprintln!("note: Steam is running, so its processes are found before the scans end");
+    }
+
+    let mut group = c.benchmark_group("processes");
+    // A scan snapshots the processes and checks the image path of each one that may be Steam's against Steam's
+    // directory.
+    group.bench_function("Steam::is_running", |b| {
+        b.iter(|| black_box(&steam).is_running())
+    });
+    group.bench_function("Tracker::new", |b| {
+        b.iter(|| Tracker::new(black_box(&steam)))
+    });
+    if let Ok(tracker) = Tracker::new(&steam) {
+        group.bench_function("Tracker::is_running", |b| {
+            b.iter(|| black_box(&tracker).is_running())
+        });
+    }
+    group.finish();
+
+    // The work behind the numbers above, per scan.
+    Timings::take();
+    let scans = 100;
+    for _ in 0..scans {
+        let _ = steam.is_running();
+    }
+    let timings = Timings::take();
+    eprintln!(
+        "a scan looks at {} processes and opens {} of them, in {:?}",
+        timings.processes_scanned / scans,
+        timings.processes_opened / scans,
+        timings.enum_processes.time / scans,
+    );
+}
+
+criterion_group!(benches, bench_processes);
+criterion_main!(benches);
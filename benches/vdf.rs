@@ -0,0 +1,180 @@
+//! Benchmarks of the VDF hot paths, over synthetic loginusers.vdf and localconfig.vdf sources of a few sizes.
+//!
+//! ```shell
+//! cargo bench --bench vdf
+//! ```
+
+use std::io::Write;
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use diverter::vdf::{self, Document, ExprId, LoginUser, Reader, Scanner, Value};
+
+/// The numbers of users in the loginusers.vdf sources, and of apps in the localconfig.vdf sources.
+const SIZES: [usize; 3] = [1, 100, 10_000];
+
+/// The SteamID64 of the first account.
+const STEAM_ID_BASE: u64 = 76561197960265728;
+
+/// Generates a loginusers.vdf source with the given number of users, laid out the way Steam writes it.
+///
+/// Every tenth persona name has escape sequences, which are rare but not unheard of.
+fn loginusers(users: usize) -> Vec<u8> {
+    let mut source = b"\"users\"\n{\n".to_vec();
+    for i in 0..users {
+        let persona = if i % 10 == 0 {
+            format!("\\\"User\\\" {i}")
+        } else {
+            format!("User {i}")
+        };
+        let _ = write!(
+            source,
+            "\t\"{steam_id}\"\n\t{{\n\
+             \t\t\"AccountName\"\t\t\"user{i}\"\n\
+             \t\t\"PersonaName\"\t\t\"{persona}\"\n\
+             \t\t\"RememberPassword\"\t\t\"1\"\n\
+             \t\t\"WantsOfflineMode\"\t\t\"0\"\n\
+             \t\t\"SkipOfflineModeWarning\"\t\t\"0\"\n\
+             \t\t\"AllowAutoLogin\"\t\t\"1\"\n\
+             \t\t\"MostRecent\"\t\t\"{most_recent}\"\n\
+             \t\t\"Timestamp\"\t\t\"{timestamp}\"\n\
+             \t}}\n",
+            steam_id = STEAM_ID_BASE + i as u64,
+            most_recent = u8::from(i == 0),
+            timestamp = 1_690_000_000 + i,
+        );
+    }
+    source.extend_from_slice(b"}\n");
+    source
+}
+
+/// Generates a localconfig.vdf source with the given number of apps, along with the other blocks Steam writes
+/// before them, which readers skip.
+fn localconfig(apps: usize) -> Vec<u8> {
+    let mut source = b"\"UserLocalConfigStore\"\n{\n\t\"friends\"\n\t{\n".to_vec();
+    for i in 0..apps.min(100) {
+        let _ = write!(
+            source,
+            "\t\t\"{i}\"\n\t\t{{\n\t\t\t\"name\"\t\t\"Friend {i}\"\n\t\t\t\"NameHistory\"\n\t\t\t{{\n\t\t\t\t\"0\"\t\t\"Friend {i}\"\n\t\t\t}}\n\t\t}}\n",
+        );
+    }
+    source.extend_from_slice(b"\t}\n\t\"Software\"\n\t{\n\t\t\"Valve\"\n\t\t{\n\t\t\t\"Steam\"\n\t\t\t{\n\t\t\t\t\"apps\"\n\t\t\t\t{\n");
+    for i in 0..apps {
+        let _ = write!(
+            source,
+            "\t\t\t\t\t\"{app}\"\n\t\t\t\t\t{{\n\
+             \t\t\t\t\t\t\"LastPlayed\"\t\t\"{last_played}\"\n\
+             \t\t\t\t\t\t\"Playtime\"\t\t\"{playtime}\"\n\
+             \t\t\t\t\t\t\"cloud\"\n\t\t\t\t\t\t{{\n\
+             \t\t\t\t\t\t\t\"last_sync_state\"\t\t\"synchronized\"\n\
+             \t\t\t\t\t\t}}\n\
+             \t\t\t\t\t}}\n",
+            app = 10 * (i + 1),
+            last_played = 1_690_000_000 + i,
+            playtime = i * 7,
+        );
+    }
+    source.extend_from_slice(b"\t\t\t\t}\n\t\t\t}\n\t\t}\n\t}\n}\n");
+    source
+}
+
+/// The ID of the "users" block in a parsed loginusers.vdf.
+fn users_block(document: &Document) -> ExprId {
+    document
+        .subkeys(ExprId::ROOT, b"users")
+        .expect("the source has a users block")
+}
+
+fn bench_loginusers(c: &mut Criterion) {
+    let mut group = c.benchmark_group("loginusers.vdf");
+    for users in SIZES {
+        let source = loginusers(users);
+        group.throughput(Throughput::Bytes(source.len() as u64));
+
+        group.bench_with_input(BenchmarkId::new("scan", users), &source, |b, source| {
+            b.iter(|| Scanner::new(black_box(source)).count())
+        });
+        group.bench_with_input(BenchmarkId::new("parse", users), &source, |b, source| {
+            b.iter(|| vdf::parse(Scanner::new(black_box(source)).map_while(Result::ok)))
+        });
+        group.bench_with_input(
+            BenchmarkId::new("scan_parse_into", users),
+            &source,
+            |b, source| {
+                let mut document = Document(Vec::new());
+                b.iter(|| vdf::scan_parse_into(black_box(source), &mut document))
+            },
+        );
+
+        let document = vdf::scan_parse(&source).expect("the source is well-formed");
+        let users_block = users_block(&document);
+        let ids: Vec<ExprId> = (0..document.0.len())
+            .map(ExprId)
+            .filter(|&id| {
+                document.get(id).is_some_and(|row| {
+                    row.parent == users_block && matches!(row.value, Value::Subkeys(_))
+                })
+            })
+            .collect();
+        group.bench_with_input(BenchmarkId::new("value_str", users), &ids, |b, ids| {
+            b.iter(|| {
+                ids.iter()
+                    .filter_map(|&id| document.value_str(id, black_box(b"AccountName")))
+                    .count()
+            })
+        });
+
+        group.bench_with_input(
+            BenchmarkId::new("LoginUser::from_vdf", users),
+            &source,
+            |b, source| {
+                b.iter(|| {
+                    LoginUser::from_vdf(black_box(source))
+                        .expect("the source has a users block")
+                        .filter(Result::is_ok)
+                        .count()
+                })
+            },
+        );
+    }
+    group.finish();
+}
+
+fn bench_localconfig(c: &mut Criterion) {
+    let mut group = c.benchmark_group("localconfig.vdf");
+    for apps in SIZES {
+        let source = localconfig(apps);
+        group.throughput(Throughput::Bytes(source.len() as u64));
+
+        group.bench_with_input(BenchmarkId::new("scan", apps), &source, |b, source| {
+            b.iter(|| Scanner::new(black_box(source)).count())
+        });
+        group.bench_with_input(
+            BenchmarkId::new("scan_parse_into", apps),
+            &source,
+            |b, source| {
+                let mut document = Document(Vec::new());
+                b.iter(|| vdf::scan_parse_into(black_box(source), &mut document))
+            },
+        );
+        group.bench_with_input(
+            BenchmarkId::new("find_block", apps),
+            &source,
+            |b, source| {
+                b.iter(|| {
+                    let mut reader = Reader::new(black_box(source));
+                    reader.find_block(&[
+                        b"UserLocalConfigStore",
+                        b"Software",
+                        b"Valve",
+                        b"Steam",
+                        b"apps",
+                    ])
+                })
+            },
+        );
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_loginusers, bench_localconfig);
+criterion_main!(benches);
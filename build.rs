@@ -4,4 +4,8 @@ fn main() {
         .file("src/windows.c")
         .warnings_into_errors(true)
         .compile("windowsutil");
+    // NtQuerySystemInformation, for the process snapshot.
+    println!("cargo:rustc-link-lib=ntdll");
+    // The token and security descriptor functions, for locking the daemon's pipe to the user.
+    println!("cargo:rustc-link-lib=advapi32");
 }
@@ -0,0 +1,185 @@
+//! Measures how long switching accounts takes end to end on this machine, from signaling Steam to exit until the
+//! next account has logged in, for each way of restarting Steam.
+//!
+//! This restarts Steam over and over, so it's kept out of the benchmarks and run on demand, with accounts that
+//! have logged in on this machine before (so that Steam doesn't ask for their passwords):
+//!
+//! ```shell
+//! cargo run --release --example switch_latency -- <CYCLES> <[restart|graceful|smart|all]> <USERNAME>...
+//! ```
+//!
+//! The accounts are cycled through, so give at least two to time actual switches.
+
+use std::{
+    process::ExitCode,
+    time::{Duration, Instant},
+};
+
+use diverter::{AccountIndex, PendingExit, Steam, Timings, Username};
+
+/// How long a kill may take, as the CLI waits.
+const KILL_TIMEOUT: Duration = Duration::from_secs(5);
+/// How long a shut down may take in smart mode before Steam is killed, as the CLI's default.
+const SMART_DEADLINE: Duration = Duration::from_secs(10);
+/// How long Steam may take to log in before a cycle is counted as failed.
+const LOGIN_TIMEOUT: Duration = Duration::from_secs(120);
+
+/// A way of restarting Steam, as the CLI's `--restart`, `--graceful` and `--smart` options do.
+#[derive(Debug, Clone, Copy)]
+enum Mode {
+    Restart,
+    Graceful,
+    Smart,
+}
+
+impl Mode {
+    fn name(self) -> &'static str {
+        match self {
+            Mode::Restart => "restart",
+            Mode::Graceful => "graceful",
+            Mode::Smart => "smart",
+        }
+    }
+
+    fn start(self, steam: &Steam) -> diverter::Result<PendingExit<'_>> {
+        match self {
+            Mode::Restart => steam.start_kill(),
+            Mode::Graceful | Mode::Smart => steam.start_shutdown(),
+        }
+    }
+
+    /// Waits for Steam to exit, returning whether it has.
+    fn wait(self, exiting: PendingExit) -> diverter::Result<bool> {
+        match self {
+            Mode::Restart => exiting.wait(Some(KILL_TIMEOUT)),
+            Mode::Graceful => exiting.wait(None),
+            Mode::Smart => exiting
+                .wait_or_kill(SMART_DEADLINE, Some(KILL_TIMEOUT))
+                .map(|_| true),
+        }
+    }
+}
+
+/// Switches to the account and waits for it to log in, returning how long it took.
+fn cycle(
+    steam: &Steam,
+    mode: Mode,
+    username: Username,
+    account_id: u32,
+) -> Result<Duration, String> {
+    let start = Instant::now();
+    let exiting = mode
+        .start(steam)
+        .map_err(|e| format!("failed to stop Steam: {e}"))?;
+    steam
+        .set_auto_login_user(username)
+        .map_err(|e| format!("failed to set the username: {e}"))?;
+    if !mode
+        .wait(exiting)
+        .map_err(|e| format!("failed to wait for Steam to exit: {e}"))?
+    {
+        return Err("Steam didn't exit in time".into());
+    }
+    steam
+        .launch_fast()
+        .map_err(|e| format!("failed to launch Steam: {e}"))?;
+    match steam.wait_login(Some(account_id), Some(LOGIN_TIMEOUT)) {
+        Ok(Some(_)) => Ok(start.elapsed()),
+        Ok(None) => Err(format!("{username} didn't log in in time")),
+        Err(e) => Err(format!("failed to wait for {username} to log in: {e}")),
+    }
+}
+
+/// Gets the nearest-rank percentile of sorted samples.
+fn percentile(sorted: &[Duration], percent: usize) -> Duration {
+    let rank = (sorted.len() * percent).div_ceil(100).max(1);
+    sorted[rank - 1]
+}
+
+fn main() -> ExitCode {
+    let args: Vec<String> = std::env::args().skip(1).collect();
+    let usage = || {
+        eprintln!("usage: switch_latency <CYCLES> <[restart|graceful|smart|all]> <USERNAME>...");
+        ExitCode::from(64)
+    };
+    let [cycles, mode, usernames @ ..] = args.as_slice() else {
+        return usage();
+    };
+    let Ok(cycles) = cycles.parse::<usize>() else {
+        return usage();
+    };
+    let modes: &[Mode] = match mode.as_str() {
+        "restart" => &[Mode::Restart],
+        "graceful" => &[Mode::Graceful],
+        "smart" => &[Mode::Smart],
+        "all" => &[Mode::Restart, Mode::Graceful, Mode::Smart],
+        _ => return usage(),
+    };
+    if cycles == 0 || usernames.is_empty() {
+        return usage();
+    }
+
+    let steam = match Steam::new() {
+        Ok(steam) => steam,
+        Err(e) => {
+            eprintln!("failed to find Steam: {e}");
+            return ExitCode::from(69);
+        }
+    };
+    let accounts = match AccountIndex::load(&steam) {
+        Ok(accounts) => accounts,
+        Err(e) => {
+            eprintln!("failed to read Steam's accounts: {e}");
+            return ExitCode::from(66);
+        }
+    };
+    let mut users = Vec::with_capacity(usernames.len());
+    for username in usernames {
+        let Ok(username) = username.parse::<Username>() else {
+            eprintln!("invalid username: {username}");
+            return ExitCode::from(64);
+        };
+        let Some(account_id) = accounts.find(username).and_then(|user| user.account_id()) else {
+            eprintln!("{username} hasn't logged in on this machine before");
+            return ExitCode::from(64);
+        };
+        users.push((username, account_id));
+    }
+
+    println!(
+        "{:<8} {:>7} {:>7} {:>8} {:>8} {:>8} {:>12} {:>11}",
+        "mode", "cycles", "failed", "p50", "p95", "p99", "wait_exit", "wait_login"
+    );
+    for &mode in modes {
+        let mut samples = Vec::with_capacity(cycles);
+        let mut failed = 0;
+        Timings::take();
+        for i in 0..cycles {
+            let (username, account_id) = users[i % users.len()];
+            match cycle(&steam, mode, username, account_id) {
+                Ok(latency) => samples.push(latency),
+                Err(e) => {
+                    eprintln!("{} cycle {}: {e}", mode.name(), i + 1);
+                    failed += 1;
+                }
+            }
+        }
+        let timings = Timings::take();
+        samples.sort_unstable();
+        if samples.is_empty() {
+            println!("{:<8} {cycles:>7} {failed:>7}", mode.name());
+            continue;
+        }
+        let per_cycle = |time: Duration| time / cycles as u32;
+        println!(
+            "{:<8} {cycles:>7} {failed:>7} {:>7.2}s {:>7.2}s {:>7.2}s {:>11.2}s {:>10.2}s",
+            mode.name(),
+            percentile(&samples, 50).as_secs_f64(),
+            percentile(&samples, 95).as_secs_f64(),
+            percentile(&samples, 99).as_secs_f64(),
+            per_cycle(timings.wait_exit.time).as_secs_f64(),
+            per_cycle(timings.wait_login.time).as_secs_f64(),
+        );
+    }
+    ExitCode::SUCCESS
+}
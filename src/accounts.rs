@@ -0,0 +1,382 @@
+//! A cache of the [`LoginUser`]s in loginusers.vdf.
+
+use std::{
+    fs, io,
+    path::PathBuf,
+    sync::{
+        atomic::{AtomicBool, AtomicU32, Ordering},
+        Arc, Mutex, PoisonError,
+    },
+    thread,
+    time::Duration,
+};
+
+use crate::{
+    stats,
+    steam::{Error, FileIdentity, Result},
+    vdf::{self, LoginUser, LoginUserVdfError},
+    Steam, Username, Watcher,
+};
+
+/// Identifies the [`AccountIndex`] format.
+const MAGIC: [u8; 4] = *b"DVAI";
+/// The [`AccountIndex`] format version, which changes whenever its layout does.
+const VERSION: u32 = 3;
+/// The length of the [`AccountIndex`] header.
+///
+/// The header consists of the magic, the version, the [`FileIdentity`] fields and the number of users.
+const HEADER_LEN: usize = 4 + 4 + 8 + 8 + 8 + 4 + 4;
+
+/// Record flag for [`LoginUser::allow_auto_login`].
+const FLAG_ALLOW_AUTO_LOGIN: u8 = 1 << 0;
+/// Record flag for [`LoginUser::most_recent`].
+const FLAG_MOST_RECENT: u8 = 1 << 1;
+/// Record flag for [`LoginUser::remember_password`].
+const FLAG_REMEMBER_PASSWORD: u8 = 1 << 2;
+/// Record flag for [`LoginUser::wants_offline_mode`].
+const FLAG_WANTS_OFFLINE_MODE: u8 = 1 << 3;
+/// The length of a user record before its strings.
+const RECORD_HEADER_LEN: usize = 2 + 2 + 2 + 1 + 8;
+
+/// The [`LoginUser`]s of a version of loginusers.vdf, in a compact binary layout which can be stored as is.
+///
+/// Each user is a record of the lengths of its strings as 16-bit integers, a byte of flags, the timestamp, and the
+/// strings. The nickname is stored unescaped, so that reading the index never copies.
+/// All integers are little-endian.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct AccountIndex {
+    buffer: Vec<u8>,
+}
+
+/// Reads a user record, returning the user and the length of the record.
+fn record(bytes: &[u8]) -> Option<(LoginUser<'_>, usize)> {
+    let len =
+        |at: usize| Some(u16::from_le_bytes(bytes.get(at..at + 2)?.try_into().ok()?) as usize);
+    let steam_id_len = len(0)?;
+    let username_len = len(2)?;
+    let nickname_len = len(4)?;
+    let flags = *bytes.get(6)?;
+    let timestamp = u64::from_le_bytes(bytes.get(7..RECORD_HEADER_LEN)?.try_into().ok()?);
+    let steam_id_end = RECORD_HEADER_LEN + steam_id_len;
+    let username_end = steam_id_end + username_len;
+    let nickname_end = username_end + nickname_len;
+    let user = LoginUser {
+        steam_id: bytes.get(RECORD_HEADER_LEN..steam_id_end)?,
+        username: bytes.get(steam_id_end..username_end)?,
+        nickname: vdf::Str::verbatim(bytes.get(username_end..nickname_end)?),
+        allow_auto_login: flags & FLAG_ALLOW_AUTO_LOGIN != 0,
+        most_recent: flags & FLAG_MOST_RECENT != 0,
+        timestamp,
+        remember_password: flags & FLAG_REMEMBER_PASSWORD != 0,
+        wants_offline_mode: flags & FLAG_WANTS_OFFLINE_MODE != 0,
+    };
+    Some((user, nickname_end))
+}
+
+impl AccountIndex {
+    /// Creates an index of the users, for the given version of loginusers.vdf.
+    ///
+    /// Users with strings that are too long for the layout are left out; Steam doesn't allow such.
+    pub fn new<'a>(identity: FileIdentity, users: impl IntoIterator<Item = LoginUser<'a>>) -> Self {
+        let mut buffer = Vec::with_capacity(HEADER_LEN + 16 * 64);
+        buffer.extend_from_slice(&MAGIC);
+        buffer.extend_from_slice(&VERSION.to_le_bytes());
+        buffer.extend_from_slice(&identity.size.to_le_bytes());
+        buffer.extend_from_slice(&identity.write_time.to_le_bytes());
+        buffer.extend_from_slice(&identity.index.to_le_bytes());
+        buffer.extend_from_slice(&identity.volume.to_le_bytes());
+        buffer.extend_from_slice(&0u32.to_le_bytes());
+        let mut count = 0u32;
+        for user in users {
+            let nickname = user.nickname.unescape();
+            let (Ok(steam_id_len), Ok(username_len), Ok(nickname_len)) = (
+                u16::try_from(user.steam_id.len()),
+                u16::try_from(user.username.len()),
+                u16::try_from(nickname.len()),
+            ) else {
+                continue;
+            };
+            buffer.extend_from_slice(&steam_id_len.to_le_bytes());
+            buffer.extend_from_slice(&username_len.to_le_bytes());
+            buffer.extend_from_slice(&nickname_len.to_le_bytes());
+            let flag = |set: bool, flag: u8| if set { flag } else { 0 };
+            buffer.push(
+                flag(user.allow_auto_login, FLAG_ALLOW_AUTO_LOGIN)
+                    | flag(user.most_recent, FLAG_MOST_RECENT)
+                    | flag(user.remember_password, FLAG_REMEMBER_PASSWORD)
+                    | flag(user.wants_offline_mode, FLAG_WANTS_OFFLINE_MODE),
+            );
+            buffer.extend_from_slice(&user.timestamp.to_le_bytes());
+            buffer.extend_from_slice(user.steam_id);
+            buffer.extend_from_slice(user.username);
+            buffer.extend_from_slice(&nickname);
+            count += 1;
+        }
+        buffer[HEADER_LEN - 4..HEADER_LEN].copy_from_slice(&count.to_le_bytes());
+        Self { buffer }
+    }
+
+    /// Reads an index from its [bytes](Self::as_bytes), checking that they're well-formed.
+    pub fn from_bytes(buffer: Vec<u8>) -> Option<Self> {
+        let header = buffer.get(..HEADER_LEN)?;
+        if header[..4] != MAGIC || header[4..8] != VERSION.to_le_bytes() {
+            return None;
+        }
+        let index = Self { buffer };
+        let mut records = &index.buffer[HEADER_LEN..];
+        for _ in 0..index.len() {
+            let (_, len) = record(records)?;
+            records = &records[len..];
+        }
+        records.is_empty().then_some(index)
+    }
+
+    /// The index's bytes, in its binary layout.
+    #[inline]
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.buffer
+    }
+
+    fn u32_at(&self, at: usize) -> u32 {
+        u32::from_le_bytes(self.buffer[at..at + 4].try_into().unwrap())
+    }
+
+    fn u64_at(&self, at: usize) -> u64 {
+        u64::from_le_bytes(self.buffer[at..at + 8].try_into().unwrap())
+    }
+
+    /// The version of loginusers.vdf the index was created from.
+    pub fn identity(&self) -> FileIdentity {
+        FileIdentity {
+            size: self.u64_at(8),
+            write_time: self.u64_at(16),
+            index: self.u64_at(24),
+            volume: self.u32_at(32),
+        }
+    }
+
+    /// The number of users.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.u32_at(HEADER_LEN - 4) as usize
+    }
+
+    /// Checks if there are no users.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Iterates the users.
+    #[inline]
+    pub fn users(&self) -> Users<'_> {
+        Users {
+            records: &self.buffer[HEADER_LEN..],
+        }
+    }
+
+    /// Finds a user by username, which Steam treats case-insensitively.
+    pub fn find(&self, username: Username) -> Option<LoginUser<'_>> {
+        self.users()
+            .find(|user| user.username.eq_ignore_ascii_case(username.as_bytes()))
+    }
+
+    /// Where the index of the current user's Steam is cached, in the local application data directory.
+    pub fn cache_path() -> Option<PathBuf> {
+        let mut path = PathBuf::from(std::env::var_os("LOCALAPPDATA")?);
+        path.push("diverter");
+        path.push("loginusers.cache");
+        Some(path)
+    }
+
+    /// Stores the index at the path, replacing the file there.
+    pub fn store(&self, path: &std::path::Path) -> io::Result<()> {
+        if let Some(dir) = path.parent() {
+            fs::create_dir_all(dir)?;
+        }
+        // Written aside and moved into place, so that concurrent loads never read a partial index. Each store stages
+        // in its own file, so that concurrent stores (e.g. of a daemon and a local run) can't interleave their writes.
+        static STAGED: AtomicU32 = AtomicU32::new(0);
+        let mut staging = path.as_os_str().to_owned();
+        staging.push(format!(
+            ".{}.{}.tmp",
+            std::process::id(),
+            STAGED.fetch_add(1, Ordering::Relaxed)
+        ));
+        let staging = PathBuf::from(staging);
+        let result = fs::write(&staging, &self.buffer).and_then(|()| fs::rename(&staging, path));
+        if result.is_err() {
+            let _ = fs::remove_file(&staging);
+        }
+        result
+    }
+
+    /// Loads the index of loginusers.vdf from the [cache](Self::cache_path), or from loginusers.vdf when it's
+    /// changed since it was cached, updating the cache.
+    ///
+    /// The cache is best-effort: failure to read or write it falls back to or keeps the parsed index.
+    pub fn load(steam: &Steam) -> Result<Self> {
+        let identity = FileIdentity::of(&steam.vdf_loginusers()?)?;
+        if let Some(index) = Self::cache_path()
+            .and_then(|path| fs::read(path).ok())
+            .and_then(Self::from_bytes)
+            .filter(|index| index.identity() == identity)
+        {
+            return Ok(index);
+        }
+        Self::parse(steam, identity)
+    }
+
+    /// Reuses `index` if it's of the current version of loginusers.vdf, and otherwise replaces it with the
+    /// [loaded](Self::load) index.
+    ///
+    /// This suits long-lived processes, which keep the index instead of reading the cache.
+    pub fn refresh<'a>(steam: &Steam, index: &'a mut Option<Self>) -> Result<&'a Self> {
+        let identity = FileIdentity::of(&steam.vdf_loginusers()?)?;
+        if index.as_ref().map(Self::identity) != Some(identity) {
+            *index = Some(Self::parse(steam, identity)?);
+        }
+        Ok(index.as_ref().unwrap())
+    }
+
+    /// Parses loginusers.vdf, of the given version, into an index and caches it.
+    fn parse(steam: &Steam, identity: FileIdentity) -> Result<Self> {
+        let source = steam.map_loginusers()?;
+        // The users are streamed into the index, rather than collected first.
+        let mut syntax_error = None;
+        let users = vdf::LoginUser::from_vdf(&source)
+            .map_err(Error::LoginUsersVdf)?
+            .map_while(|user| match user {
+                Ok(user) => Some(Some(user)),
+                Err(e @ LoginUserVdfError::Syntax(_)) => {
+                    syntax_error = Some(e);
+                    None
+                }
+                Err(_) => Some(None),
+            })
+            .flatten();
+        let index = stats::time_parse(|| Self::new(identity, users));
+        if let Some(e) = syntax_error {
+            return Err(Error::LoginUsersVdf(e));
+        }
+        drop(source);
+        if let Some(path) = Self::cache_path() {
+            let _ = index.store(&path);
+        }
+        Ok(index)
+    }
+}
+
+/// An iterator over the users of an [`AccountIndex`], see [`AccountIndex::users`].
+#[derive(Debug, Clone)]
+pub struct Users<'a> {
+    records: &'a [u8],
+}
+
+impl<'a> Iterator for Users<'a> {
+    type Item = LoginUser<'a>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let (user, len) = record(self.records)?;
+        self.records = &self.records[len..];
+        Some(user)
+    }
+}
+
+/// How long [`SharedAccounts::watch`] waits for loginusers.vdf to settle after a change, since Steam may write it in
+/// several steps.
+const SETTLE_TIME: Duration = Duration::from_millis(100);
+
+/// An [`AccountIndex`] shared across threads, which is replaced as a whole when loginusers.vdf changes.
+///
+/// A new index is parsed aside and then swapped in, so readers never wait on a parse.
+#[derive(Debug, Clone)]
+pub struct SharedAccounts(Arc<SharedAccountsInner>);
+
+#[derive(Debug)]
+struct SharedAccountsInner {
+    index: Mutex<Arc<AccountIndex>>,
+    /// Whether a watcher keeps the index current, in which case readers needn't check loginusers.vdf.
+    watching: AtomicBool,
+}
+
+impl SharedAccounts {
+    /// [Loads](AccountIndex::load) the index, which [`Self::current`] refreshes when loginusers.vdf changes.
+    pub fn load(steam: &Steam) -> Result<Self> {
+        Ok(Self(Arc::new(SharedAccountsInner {
+            index: Mutex::new(Arc::new(AccountIndex::load(steam)?)),
+            watching: AtomicBool::new(false),
+        })))
+    }
+
+    /// [Loads](Self::load) the index, and keeps it current from a thread that watches Steam's config directory, so
+    /// that [`Self::current`] doesn't need to check loginusers.vdf.
+    ///
+    /// If watching fails later on, [`Self::current`] goes back to checking loginusers.vdf.
+    pub fn watch(steam: &Steam) -> Result<Self> {
+        // Watching starts before loading, so that changes in between aren't missed.
+        let watcher = Watcher::new(steam, "config")?;
+        let thread_steam = Steam::new()?;
+        let accounts = Self::load(steam)?;
+        accounts.0.watching.store(true, Ordering::Release);
+        let watched = accounts.clone();
+        let spawned = thread::Builder::new()
+            .name("loginusers.vdf watcher".into())
+            .spawn(move || {
+                let _ = watched.keep_current(&thread_steam, watcher);
+                watched.0.watching.store(false, Ordering::Release);
+            });
+        if let Err(e) = spawned {
+            accounts.0.watching.store(false, Ordering::Release);
+            return Err(Error::Watch(e));
+        }
+        Ok(accounts)
+    }
+
+    /// Replaces the index whenever loginusers.vdf changes, until watching fails.
+    fn keep_current(&self, steam: &Steam, mut watcher: Watcher) -> Result<()> {
+        loop {
+            if !watcher.wait("loginusers.vdf", None)? {
+                continue;
+            }
+            while watcher.wait("loginusers.vdf", Some(SETTLE_TIME))? {}
+            // A failed refresh keeps the current index, and is retried on the next change.
+            let _ = self.refresh(steam);
+        }
+    }
+
+    /// Replaces the index if loginusers.vdf has changed since, returning the current index.
+    fn refresh(&self, steam: &Steam) -> Result<Arc<AccountIndex>> {
+        let index = self.get();
+        let identity = FileIdentity::of(&steam.vdf_loginusers()?)?;
+        if index.identity() == identity {
+            return Ok(index);
+        }
+        let index = Arc::new(AccountIndex::parse(steam, identity)?);
+        *self.0.index.lock().unwrap_or_else(PoisonError::into_inner) = Arc::clone(&index);
+        Ok(index)
+    }
+
+    /// The index as is.
+    #[inline]
+    fn get(&self) -> Arc<AccountIndex> {
+        Arc::clone(&self.0.index.lock().unwrap_or_else(PoisonError::into_inner))
+    }
+
+    /// The index of the current version of loginusers.vdf.
+    ///
+    /// While [watching](Self::watch), it's the latest index the watcher has swapped in.
+    pub fn current(&self, steam: &Steam) -> Result<Arc<AccountIndex>> {
+        if self.is_watching() {
+            Ok(self.get())
+        } else {
+            self.refresh(steam)
+        }
+    }
+
+    /// Whether a watcher keeps the index current.
+    #[inline]
+    pub fn is_watching(&self) -> bool {
+        self.0.watching.load(Ordering::Acquire)
+    }
+}
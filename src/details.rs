@@ -0,0 +1,257 @@
+//! Details about Steam's accounts and libraries beyond loginusers.vdf, which are spread across several of Steam's
+//! files.
+
+use std::{
+    num::NonZeroUsize,
+    sync::atomic::{AtomicUsize, Ordering},
+    thread,
+};
+
+use crate::{
+    stats,
+    vdf::{Event, Reader, ScanParseError},
+    AccountIndex, Steam,
+};
+
+/// The most threads [`Details::load`] loads files on.
+const MAX_THREADS: usize = 4;
+
+/// A Steam library folder.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Library {
+    /// The folder's path.
+    pub path: String,
+    /// The number of apps installed in the folder, or [`None`] if unknown.
+    pub apps: Option<usize>,
+}
+
+/// An account's details from its `userdata\<account ID>\config\localconfig.vdf`.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct AccountDetails {
+    /// The number of apps the account has local settings for, which are the apps it has played on this machine.
+    pub apps: usize,
+}
+
+/// Details about Steam's accounts and libraries, see [`Details::load`].
+#[derive(Debug, Default, Clone)]
+pub struct Details {
+    /// The library folders, from `steamapps\libraryfolders.vdf` and `config\config.vdf`.
+    pub libraries: Vec<Library>,
+    /// The accounts' details, by account ID, sorted.
+    accounts: Vec<(u32, AccountDetails)>,
+}
+
+/// A file for [`Details::load`] to load.
+#[derive(Debug, Clone, Copy)]
+enum Job {
+    LibraryFolders,
+    Config,
+    LocalConfig(u32),
+}
+
+/// What a [`Job`] loaded.
+#[derive(Debug)]
+enum Loaded {
+    Libraries(Vec<Library>),
+    BaseInstallFolders(Vec<String>),
+    Account(u32, AccountDetails),
+}
+
+impl Details {
+    /// Loads the details of the libraries and of the users in the index.
+    ///
+    /// The files are mapped and parsed concurrently on a few threads, so that loading takes about as long as the
+    /// largest file does. The details are best-effort: missing or malformed files are left out.
+    pub fn load(steam: &Steam, accounts: &AccountIndex) -> Self {
+        let jobs: Vec<Job> = [Job::LibraryFolders, Job::Config]
+            .into_iter()
+            .chain(
+                accounts
+                    .users()
+                    .filter_map(|user| user.account_id())
+                    .map(Job::LocalConfig),
+            )
+            .collect();
+        let threads = thread::available_parallelism()
+            .map_or(1, NonZeroUsize::get)
+            .min(MAX_THREADS)
+            .min(jobs.len());
+        let next = AtomicUsize::new(0);
+        let work = || {
+            let mut loaded = Vec::new();
+            while let Some(&job) = jobs.get(next.fetch_add(1, Ordering::Relaxed)) {
+                loaded.extend(job.run(steam));
+            }
+            loaded
+        };
+        let loaded: Vec<Loaded> = thread::scope(|scope| {
+            let workers: Vec<_> = (1..threads).map(|_| scope.spawn(work)).collect();
+            // The current thread works too, rather than just waiting.
+            let mut loaded = work();
+            for worker in workers {
+                // Workers don't panic short of a bug, which aborts in release anyway.
+                loaded.extend(worker.join().unwrap_or_default());
+            }
+            loaded
+        });
+
+        let mut details = Self::default();
+        let mut base_install_folders = Vec::new();
+        for loaded in loaded {
+            match loaded {
+                Loaded::Libraries(libraries) => details.libraries = libraries,
+                Loaded::BaseInstallFolders(folders) => base_install_folders = folders,
+                Loaded::Account(account_id, account) => {
+                    details.accounts.push((account_id, account))
+                }
+            }
+        }
+        // Older versions of Steam listed the libraries besides Steam's own in config.vdf, which newer versions keep.
+        for path in base_install_folders {
+            if !details
+                .libraries
+                .iter()
+                .any(|library| library.path.eq_ignore_ascii_case(&path))
+            {
+                details.libraries.push(Library { path, apps: None });
+            }
+        }
+        details
+            .accounts
+            .sort_unstable_by_key(|&(account_id, _)| account_id);
+        details
+    }
+
+    /// Gets an account's details by its [account ID](crate::vdf::LoginUser::account_id).
+    pub fn account(&self, account_id: u32) -> Option<&AccountDetails> {
+        self.accounts
+            .binary_search_by_key(&account_id, |&(account_id, _)| account_id)
+            .ok()
+            .map(|i| &self.accounts[i].1)
+    }
+}
+
+impl Job {
+    /// Maps and parses the job's file, returning [`None`] if it's missing or malformed.
+    fn run(self, steam: &Steam) -> Option<Loaded> {
+        match self {
+            Job::LibraryFolders => {
+                let source = steam.map_file("steamapps\\libraryfolders.vdf").ok()?;
+                stats::time_parse(|| library_folders(&source))
+                    .ok()
+                    .map(Loaded::Libraries)
+            }
+            Job::Config => {
+                let source = steam.map_file("config\\config.vdf").ok()?;
+                stats::time_parse(|| base_install_folders(&source))
+                    .ok()
+                    .map(Loaded::BaseInstallFolders)
+            }
+            Job::LocalConfig(account_id) => {
+                let source = steam
+                    .map_file(format!("userdata\\{account_id}\\config\\localconfig.vdf"))
+                    .ok()?;
+                stats::time_parse(|| local_config(&source))
+                    .ok()
+                    .map(|account| Loaded::Account(account_id, account))
+            }
+        }
+    }
+}
+
+/// Counts the entries of the current block, skipping it to its end.
+fn count_entries(reader: &mut Reader) -> Result<usize, ScanParseError> {
+    let mut count = 0;
+    loop {
+        match reader.next().transpose()? {
+            Some(Event::KeyValue(..)) => count += 1,
+            Some(Event::Enter(_)) => {
+                count += 1;
+                reader.skip_block()?;
+            }
+            Some(Event::Exit) | None => break Ok(count),
+        }
+    }
+}
+
+/// Reads the libraries in a libraryfolders.vdf source.
+fn library_folders(source: &[u8]) -> Result<Vec<Library>, ScanParseError> {
+    let mut libraries = Vec::new();
+    let mut reader = Reader::new(source);
+    if !reader.find_block(&[b"libraryfolders"])? {
+        return Ok(libraries);
+    }
+    loop {
+        match reader.next().transpose()? {
+            // A library's block.
+            Some(Event::Enter(_)) => {
+                let mut path = None;
+                let mut apps = None;
+                loop {
+                    match reader.next().transpose()? {
+                        Some(Event::KeyValue(b"path", value)) => {
+                            path.get_or_insert(value);
+                        }
+                        Some(Event::KeyValue(..)) => {}
+                        Some(Event::Enter(b"apps")) => apps = Some(count_entries(&mut reader)?),
+                        Some(Event::Enter(_)) => reader.skip_block()?,
+                        Some(Event::Exit) | None => break,
+                    }
+                }
+                if let Some(path) = path {
+                    libraries.push(Library {
+                        path: path.to_string_lossy().into_owned(),
+                        apps,
+                    });
+                }
+            }
+            // Older versions of Steam list libraries by their index, without their apps.
+            Some(Event::KeyValue(key, value)) if key.iter().all(u8::is_ascii_digit) => {
+                libraries.push(Library {
+                    path: value.to_string_lossy().into_owned(),
+                    apps: None,
+                });
+            }
+            Some(Event::KeyValue(..)) => {}
+            Some(Event::Exit) | None => break,
+        }
+    }
+    Ok(libraries)
+}
+
+/// Reads the "BaseInstallFolder_<n>" library folders in a config.vdf source.
+fn base_install_folders(source: &[u8]) -> Result<Vec<String>, ScanParseError> {
+    let mut folders = Vec::new();
+    let mut reader = Reader::new(source);
+    if !reader.find_block(&[b"InstallConfigStore", b"Software", b"Valve", b"Steam"])? {
+        return Ok(folders);
+    }
+    loop {
+        match reader.next().transpose()? {
+            Some(Event::KeyValue(key, value)) if key.starts_with(b"BaseInstallFolder_") => {
+                folders.push(value.to_string_lossy().into_owned());
+            }
+            Some(Event::KeyValue(..)) => {}
+            Some(Event::Enter(_)) => reader.skip_block()?,
+            Some(Event::Exit) | None => break,
+        }
+    }
+    Ok(folders)
+}
+
+/// Reads an account's details from its localconfig.vdf source.
+fn local_config(source: &[u8]) -> Result<AccountDetails, ScanParseError> {
+    let mut reader = Reader::new(source);
+    let apps = if reader.find_block(&[
+        b"UserLocalConfigStore",
+        b"Software",
+        b"Valve",
+        b"Steam",
+        b"apps",
+    ])? {
+        count_entries(&mut reader)?
+    } else {
+        0
+    };
+    Ok(AccountDetails { apps })
+}
@@ -7,7 +7,24 @@ mod username;
 pub use username::{Username, UsernameError};
 
 mod steam;
-pub use steam::{Error, Result, Steam};
+pub use steam::{Error, FileIdentity, FileView, PendingExit, Result, Snapshot, Status, Steam};
+
+mod accounts;
+pub use accounts::{AccountIndex, SharedAccounts, Users};
+
+mod details;
+pub use details::{AccountDetails, Details, Library};
+
+mod stats;
+pub use stats::{PhaseTiming, Timings};
+
+mod tracker;
+pub use tracker::Tracker;
+
+mod watch;
+pub use watch::Watcher;
+
+pub mod pipe;
 
 pub mod vdf;
 
@@ -1,7 +1,19 @@
-use std::{io::Read, process::ExitCode, time::Duration};
+use std::{
+    ffi::OsString,
+    fmt::Write as _,
+    fs::File,
+    io::{self, LineWriter, Write},
+    iter,
+    process::{self, ExitCode},
+    sync::Arc,
+    time::{Duration, Instant},
+};
 
 use clap::Parser;
-use diverter::{vdf, Steam, Username};
+use diverter::{
+    pipe::{self, Connection, FrameKind, FrameWriter},
+    AccountIndex, Details, SharedAccounts, Snapshot, Status, Steam, Timings, Tracker, Username,
+};
 
 #[derive(clap::Parser, Debug)]
 #[command(author, version, about, long_about = None)]
@@ -11,9 +23,28 @@ pub struct Cli {
     /// Print with color. Leave unspecified for auto.
     #[arg(short, long)]
     color: Option<bool>,
+    /// Run the command in this process, even if a daemon is running.
+    #[arg(long)]
+    local: bool,
+    /// Print where the command spent its time to stderr, as text or as a line of JSON.
+    #[arg(
+        long,
+        value_name = "FORMAT",
+        num_args = 0..=1,
+        require_equals = true,
+        default_missing_value = "text"
+    )]
+    timings: Option<TimingsFormat>,
 }
 
-#[derive(Debug, Clone, Copy, clap::Subcommand)]
+/// The format of `--timings`.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, clap::ValueEnum)]
+enum TimingsFormat {
+    Text,
+    Json,
+}
+
+#[derive(Debug, Clone, clap::Subcommand)]
 enum Command {
     #[command(alias = "g")]
     /// Prints the current account.
@@ -31,132 +62,888 @@ enum Command {
         /// Implies --restart.
         #[arg(short, long)]
         graceful: bool,
+        /// Restarts the Steam client gracefully, but kills it if it's still running after --deadline.
+        ///
+        /// Implies --restart.
+        #[arg(short, long, conflicts_with = "graceful")]
+        smart: bool,
+        /// How many seconds --smart waits for Steam to shut down before killing it.
+        #[arg(short, long, default_value_t = 10, value_name = "SECONDS")]
+        deadline: u64,
         /// After restart, allows Steam to verify file integrity.
         ///
         /// Implies --restart.
         #[arg(short, long)]
         verify: bool,
+        /// Launch Steam inside a job object, so later kills and checks don't need to scan processes.
+        ///
+        /// Only applies when Steam is restarted.
+        #[arg(short, long)]
+        job: bool,
+        /// After restart, waits up to SECONDS for Steam to log in to the account.
+        ///
+        /// Exits with code 75 if it doesn't.
+        #[arg(short, long, value_name = "SECONDS")]
+        wait: Option<u64>,
+        /// Also marks the account as the most recent one in loginusers.vdf, and allows it to auto-login.
+        ///
+        /// Applied while Steam is closed, so it requires Steam to be restarted or not running.
+        #[arg(short, long)]
+        most_recent: bool,
     },
     /// Lists registered Steam users.
     #[command(alias = "l", alias = "ls")]
-    List,
+    List {
+        /// Also print each user's last login and game count, and Steam's library folders.
+        #[arg(short, long)]
+        details: bool,
+    },
+    /// Prints whether Steam is running and the current account.
+    Status {
+        /// Print as JSON, along with the users that have logged in to Steam on this machine.
+        #[arg(short, long)]
+        json: bool,
+    },
+    /// Runs a daemon that keeps Steam's state loaded, which later invocations pass their commands to.
+    Serve,
+    /// Switches to each account in turn, restarting Steam and running COMMAND once Steam has logged in.
+    ///
+    /// The batch keeps one Steam context, account index and process tracker throughout, and launches Steam inside a
+    /// job object, so that each restart waits on events and kills Steam without scanning processes.
+    /// COMMAND gets the account in the DIVERTER_USERNAME and DIVERTER_ACCOUNT_ID environment variables.
+    ///
+    /// Exits with code 75 if any account didn't log in or its command failed.
+    RunEach {
+        /// The usernames of the accounts, in order.
+        #[arg(required = true)]
+        usernames: Vec<Username>,
+        /// Restarts the Steam client gracefully.
+        #[arg(short, long)]
+        graceful: bool,
+        /// Restarts the Steam client gracefully, but kills it if it's still running after --deadline.
+        #[arg(short, long, conflicts_with = "graceful")]
+        smart: bool,
+        /// How many seconds --smart waits for Steam to shut down before killing it.
+        #[arg(short, long, default_value_t = 10, value_name = "SECONDS")]
+        deadline: u64,
+        /// How many seconds to wait for Steam to log in to each account, after which the account is skipped.
+        #[arg(short, long, default_value_t = 60, value_name = "SECONDS")]
+        wait: u64,
+        /// Also marks each account as the most recent one in loginusers.vdf, and allows it to auto-login.
+        #[arg(short, long)]
+        most_recent: bool,
+        /// The command to run for each account, after `--`. Without one, Steam is only switched to each account.
+        #[arg(last = true, value_name = "COMMAND")]
+        command: Vec<OsString>,
+    },
 }
 
-fn main() -> ExitCode {
-    let cli = Cli::parse();
+/// How long to wait for killed Steam processes to exit before relaunching Steam.
+const KILL_TIMEOUT: Duration = Duration::from_secs(5);
+
+/// How long a client waits for the daemon to finish serving other clients.
+const CONNECT_TIMEOUT: Duration = Duration::from_secs(10);
+
+/// Writes a line, ignoring failure, since a command carries on even if its output can't be written.
+macro_rules! say {
+    ($writer:expr, $($arg:tt)*) => {{
+        let _ = writeln!($writer, $($arg)*);
+    }};
+}
+
+/// The state commands keep between runs.
+///
+/// A single command gets a fresh context, whereas the daemon keeps it for all of its commands.
+#[derive(Debug, Default)]
+struct Context {
+    steam: Option<Steam>,
+    /// The daemon's account index, which a watcher keeps current.
+    accounts: Option<SharedAccounts>,
+    /// Only the daemon tracks Steam's processes, since tracking costs about a scan to set up.
+    tracker: Option<Tracker>,
+}
 
+/// Finds Steam on first use, and otherwise reuses it.
+fn steam(steam: &mut Option<Steam>) -> diverter::Result<&Steam> {
+    if steam.is_none() {
+        *steam = Some(Steam::new()?);
+    }
+    Ok(steam.as_ref().unwrap())
+}
+
+/// Checks if Steam is running, using the tracker if there's one.
+fn is_running(steam: &Steam, tracker: Option<&Tracker>) -> diverter::Result<bool> {
+    match tracker {
+        Some(tracker) => tracker.is_running(),
+        None => steam.is_running(),
+    }
+}
+
+/// Gets the account index, from the shared index if there's one.
+fn accounts(steam: &Steam, shared: Option<&SharedAccounts>) -> diverter::Result<Arc<AccountIndex>> {
+    match shared {
+        Some(shared) => shared.current(steam),
+        None => AccountIndex::load(steam).map(Arc::new),
+    }
+}
+
+/// Looks up the user among the users that have logged in to Steam on this machine before.
+///
+/// Returns [`None`] when it can't be determined, [`Some(None)`](Some) when the user isn't listed,
+/// and otherwise the user's account ID.
+fn login_user_account_id(
+    steam: &Steam,
+    accounts: Option<&SharedAccounts>,
+    username: Username,
+) -> Option<Option<u32>> {
+    let accounts = self::accounts(steam, accounts).ok()?;
+    Some(accounts.find(username).and_then(|user| user.account_id()))
+}
+
+/// Marks the user as the most recent one in loginusers.vdf, reporting failures.
+fn select_login_user(steam: &Steam, username: Username, err: &mut dyn Write) {
+    match steam.select_login_user(username) {
+        Ok(true) => {}
+        Ok(false) => say!(
+            err,
+            "{username} isn't in the logged in users data to be marked as the most recent account"
+        ),
+        Err(e) => say!(
+            err,
+            "Failed to mark {username} as the most recent account: {e}"
+        ),
+    }
+}
+
+/// Formats a Unix timestamp as a UTC date and time, e.g. "2023-07-22 04:26 UTC".
+fn utc_time(timestamp: u64) -> String {
+    let days = (timestamp / 86_400) as i64;
+    let seconds = timestamp % 86_400;
+    // Howard Hinnant's `civil_from_days`, with years starting in March so that leap days end them.
+    let z = days + 719_468;
+    let era = z.div_euclid(146_097);
+    let day_of_era = z.rem_euclid(146_097);
+    let year_of_era =
+        (day_of_era - day_of_era / 1_460 + day_of_era / 36_524 - day_of_era / 146_096) / 365;
+    let day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    let month_from_march = (5 * day_of_year + 2) / 153;
+    let day = day_of_year - (153 * month_from_march + 2) / 5 + 1;
+    let month = if month_from_march < 10 {
+        month_from_march + 3
+    } else {
+        month_from_march - 9
+    };
+    let year = era * 400 + year_of_era + i64::from(month <= 2);
+    format!(
+        "{year}-{month:02}-{day:02} {:02}:{:02} UTC",
+        seconds / 3_600,
+        seconds / 60 % 60,
+    )
+}
+
+/// Writes the bytes as a JSON string, replacing invalid UTF-8.
+fn json_string(json: &mut String, s: &[u8]) {
+    json.push('"');
+    for c in String::from_utf8_lossy(s).chars() {
+        match c {
+            '"' => json.push_str("\\\""),
+            '\\' => json.push_str("\\\\"),
+            '\n' => json.push_str("\\n"),
+            '\r' => json.push_str("\\r"),
+            '\t' => json.push_str("\\t"),
+            c if c < ' ' => {
+                let _ = write!(json, "\\u{:04x}", c as u32);
+            }
+            c => json.push(c),
+        }
+    }
+    json.push('"');
+}
+
+/// Formats the snapshot as a JSON object.
+fn snapshot_json(snapshot: &Snapshot) -> String {
+    let Status {
+        auto_login_user,
+        running,
+        active_user,
+    } = snapshot.status;
+    let mut json = String::with_capacity(128 + 192 * snapshot.accounts.len());
+    let _ = write!(json, "{{\"running\":{running},\"auto_login_user\":");
+    match auto_login_user {
+        Some(username) => json_string(&mut json, username.as_bytes()),
+        None => json.push_str("null"),
+    }
+    json.push_str(",\"active_user\":");
+    match active_user {
+        Some(account_id) => {
+            let _ = write!(json, "{account_id}");
+        }
+        None => json.push_str("null"),
+    }
+    json.push_str(",\"accounts\":[");
+    for (i, user) in snapshot.accounts.users().enumerate() {
+        if i != 0 {
+            json.push(',');
+        }
+        // The SteamID is a string, since it exceeds the integers JSON parsers commonly support.
+        json.push_str("{\"steam_id\":");
+        json_string(&mut json, user.steam_id);
+        json.push_str(",\"username\":");
+        json_string(&mut json, user.username);
+        json.push_str(",\"nickname\":");
+        json_string(&mut json, &user.nickname.unescape());
+        let _ = write!(
+            json,
+            ",\"most_recent\":{},\"allow_auto_login\":{},\"remember_password\":{},\"wants_offline_mode\":{},\"timestamp\":{}}}",
+            user.most_recent,
+            user.allow_auto_login,
+            user.remember_password,
+            user.wants_offline_mode,
+            user.timestamp,
+        );
+    }
+    json.push_str("]}");
+    json
+}
+
+/// How [`switch`] restarts Steam.
+#[derive(Debug, Clone, Copy)]
+struct Restart {
+    /// Whether to shut Steam down gracefully.
+    graceful: bool,
+    /// Whether to shut Steam down gracefully, but kill it if it's still running after the deadline.
+    smart: bool,
+    /// The `smart` shutdown's deadline, in seconds.
+    deadline: u64,
+    /// Whether to allow Steam to verify its files.
+    verify: bool,
+    /// Whether to launch Steam inside a job object.
+    job: bool,
+    /// How many seconds to wait for Steam to log in, if at all.
+    wait: Option<u64>,
+}
+
+/// Switches to the account, restarting Steam if given how to, and returns the exit code.
+fn switch(
+    steam: &Steam,
+    accounts: Option<&SharedAccounts>,
+    tracker: Option<&Tracker>,
+    username: Username,
+    restart: Option<Restart>,
+    most_recent: bool,
+    err: &mut dyn Write,
+) -> u8 {
+    // Steam takes a while to exit, so it's signaled first and waited on after the rest of the switch.
+    let exiting = restart.map(|restart| {
+        if restart.graceful || restart.smart {
+            steam.start_shutdown().map(|exiting| match tracker {
+                Some(tracker) => exiting.tracked(tracker),
+                None => exiting,
+            })
+        } else {
+            steam.start_kill()
+        }
+    });
+
+    // note: when restarting, Steam is relaunched (to the previous user) even if this fails.
+    let set_result = steam.set_auto_login_user(username);
+    if let Err(e) = &set_result {
+        say!(err, "Failed to set the new username: {e}");
+    }
+    let account_id = login_user_account_id(steam, accounts, username);
+    if account_id == Some(None) {
+        say!(err, "⚠️ {username} hasn't logged in on this machine before, Steam will ask for its password");
+    }
+
+    if let (
+        Some(exiting),
+        Some(Restart {
+            graceful,
+            smart,
+            deadline,
+            verify,
+            job,
+            wait,
+        }),
+    ) = (exiting, restart)
+    {
+        // whether Steam has been killed, rather than shut down.
+        let kill_result = match exiting {
+            Ok(exiting) if smart => {
+                exiting.wait_or_kill(Duration::from_secs(deadline), Some(KILL_TIMEOUT))
+            }
+            Err(e) if smart => {
+                say!(err, "Failed to shut down Steam ({e}), killing it instead..");
+                steam.kill(Some(KILL_TIMEOUT)).map(|_| true)
+            }
+            Ok(exiting) if graceful => exiting.wait(None).map(|_| false),
+            Ok(exiting) => match exiting.wait(Some(KILL_TIMEOUT)) {
+                Ok(true) => Ok(true),
+                Ok(false) => Err(diverter::Error::KillSteam(
+                    std::io::ErrorKind::TimedOut.into(),
+                )),
+                Err(e) => Err(e),
+            },
+            Err(e) => Err(e),
+        };
+
+        let kill_method_verb = if graceful || smart {
+            "shut down"
+        } else {
+            "kill"
+        };
+        match &kill_result {
+            Ok(true) => say!(err, "🔪 Steam has been killed"),
+            Ok(false) => say!(err, "🛑 Steam has been shut down"),
+            Err(e) => say!(err, "Failed to {kill_method_verb} Steam to restart it ({e}). Will still try to launch it.."),
+        }
+        if most_recent && kill_result.is_ok() {
+            select_login_user(steam, username, err);
+        }
+
+        let launch_result = if job {
+            steam.launch_in_job(verify)
+        } else if verify {
+            steam.launch()
+        } else {
+            steam.launch_fast()
+        };
+        match &launch_result {
+            Ok(()) => say!(err, "🚀 launched Steam"),
+            Err(e) => {
+                say!(err, "Failed to re-launch Steam: {e}");
+            }
+        }
+
+        if let (Some(wait), Ok(())) = (wait, launch_result) {
+            match steam.wait_login(account_id.flatten(), Some(Duration::from_secs(wait))) {
+                Ok(Some(_)) => say!(err, "✅ Steam has logged in"),
+                Ok(None) => {
+                    say!(err, "Steam hasn't logged in within {wait} seconds");
+                    return 75;
+                }
+                Err(e) => {
+                    say!(err, "Failed to wait for Steam to log in: {e}");
+                    return e.exit_code();
+                }
+            }
+        }
+    }
+
+    if most_recent && restart.is_none() {
+        match is_running(steam, tracker) {
+            Ok(false) => select_login_user(steam, username, err),
+            Ok(true) => say!(err, "Steam is running, so {username} can't be marked as the most recent account without --restart"),
+            Err(e) => say!(err, "Failed to check whether Steam is running, so {username} wasn't marked as the most recent account: {e}"),
+        }
+    }
+
+    if let Err(e) = set_result {
+        return e.exit_code();
+    }
+
+    0
+}
+
+/// Formats the timings of a command that took `total` as a JSON object.
+fn timings_json(total: Duration, timings: &Timings) -> String {
+    let mut json = String::with_capacity(512);
+    let _ = write!(
+        json,
+        "{{\"total_ms\":{:.3},\"phases\":{{",
+        total.as_secs_f64() * 1e3
+    );
+    for (i, (name, phase)) in timings.phases().into_iter().enumerate() {
+        if i != 0 {
+            json.push(',');
+        }
+        let _ = write!(
+            json,
+            "\"{name}\":{{\"ms\":{:.3},\"count\":{}}}",
+            phase.time.as_secs_f64() * 1e3,
+            phase.count,
+        );
+    }
+    let _ = write!(
+        json,
+        "}},\"processes_scanned\":{},\"processes_opened\":{},\"processes_terminated\":{}}}",
+        timings.processes_scanned, timings.processes_opened, timings.processes_terminated,
+    );
+    json
+}
+
+/// Prints the timings of a command that took `total`, leaving out the phases it didn't go through.
+fn print_timings(err: &mut dyn Write, total: Duration, timings: &Timings) {
+    // Formatted into one buffer, so that the report isn't interleaved with other output.
+    let mut report = format!("⏱️ {:.1} ms in total\n", total.as_secs_f64() * 1e3);
+    for (name, phase) in timings.phases() {
+        if phase.count != 0 {
+            let _ = writeln!(
+                report,
+                "  {name:<16}{:>10.1} ms  ({} ops)",
+                phase.time.as_secs_f64() * 1e3,
+                phase.count,
+            );
+        }
+    }
+    let _ = writeln!(
+        report,
+        "  processes: {} scanned, {} opened, {} terminated",
+        timings.processes_scanned, timings.processes_opened, timings.processes_terminated,
+    );
+    let _ = err.write_all(report.as_bytes());
+}
+
+/// Runs the command, returning its exit code, and reports its timings if asked to.
+fn run(cli: Cli, context: &mut Context, out: &mut dyn Write, err: &mut dyn Write) -> u8 {
+    let Some(format) = cli.timings else {
+        return run_command(cli, context, out, err);
+    };
+    // Discards what was timed before the command, e.g. by the daemon in the background.
+    Timings::take();
+    let start = Instant::now();
+    let code = run_command(cli, context, out, err);
+    let total = start.elapsed();
+    let timings = Timings::take();
+    match format {
+        TimingsFormat::Text => print_timings(err, total, &timings),
+        TimingsFormat::Json => say!(err, "{}", timings_json(total, &timings)),
+    }
+    code
+}
+
+/// Runs the command, returning its exit code.
+fn run_command(cli: Cli, context: &mut Context, out: &mut dyn Write, err: &mut dyn Write) -> u8 {
     match cli.command {
-        Command::Get => match Steam::get_auto_login_user() {
-            Ok(username) => println!("{username}"),
-            Err(e) => eprintln!("Error: {e}"),
-        },
+        Command::Get => {
+            match steam(&mut context.steam).and_then(|steam| steam.get_auto_login_user()) {
+                Ok(username) => say!(out, "{username}"),
+                Err(e) => say!(err, "Error: {e}"),
+            }
+        }
         Command::Set {
             username,
             restart,
             graceful,
+            smart,
+            deadline,
             verify,
+            job,
+            wait,
+            most_recent,
         } => {
-            if let Err(e) = Steam::set_auto_login_user(username) {
-                eprintln!("Failed to set the new username: {e}");
-                return ExitCode::from(&e);
-            }
-            if restart || graceful || verify {
-                match Steam::new() {
-                    Ok(steam) => {
-                        let (kill_method, kill_method_verb, kill_symbol, kill_result) = if graceful
-                        {
-                            (
-                                "shut down",
-                                "shut down",
-                                "🛑",
-                                steam.shutdown_poll(Duration::from_millis(100)),
-                            )
-                        } else {
-                            ("killed", "kill", "🔪", steam.kill().map(|_| ()))
-                        };
-
-                        match kill_result {
-                                Ok(()) => eprintln!("{kill_symbol} Steam has been {kill_method}"),
-                                Err(e) => eprintln!("Failed to {kill_method_verb} Steam to restart it ({e}). Will still try to launch it..")
-                            }
-
-                        let launch_result = if verify {
-                            steam.launch()
-                        } else {
-                            steam.launch_fast()
-                        };
-                        match launch_result {
-                            Ok(()) => eprintln!("🚀 launched Steam"),
-                            Err(e) => {
-                                eprintln!("Failed to re-launch Steam: {e}");
-                            }
-                        }
-                    }
-                    Err(e) => {
-                        eprintln!("Failed to find Steam to restart it: {e}");
-                    }
+            let steam = match steam(&mut context.steam) {
+                Ok(steam) => steam,
+                Err(e) => {
+                    say!(err, "Failed to find Steam: {e}");
+                    return e.exit_code();
                 }
+            };
+            let restart = (restart || graceful || smart || verify).then_some(Restart {
+                graceful,
+                smart,
+                deadline,
+                verify,
+                job,
+                wait,
+            });
+            let code = switch(
+                steam,
+                context.accounts.as_ref(),
+                context.tracker.as_ref(),
+                username,
+                restart,
+                most_recent,
+                err,
+            );
+            if code != 0 {
+                return code;
             }
         }
-        Command::List => match Steam::new() {
-            Ok(steam) => match steam.vdf_loginusers() {
-                Ok(mut vdf_file) => {
+        Command::List { details } => match steam(&mut context.steam) {
+            Ok(steam) => match accounts(steam, context.accounts.as_ref()) {
+                Ok(accounts) => {
                     let should_color = cli.color.unwrap_or_else(|| atty::is(atty::Stream::Stdout));
-                    let mut vdf_source = String::with_capacity(4096);
-                    if let Err(e) = vdf_file.read_to_string(&mut vdf_source) {
-                        eprintln!("Failed to read logged in users data: {e}");
-                        return ExitCode::from(69);
-                    }
+                    let existing_username = steam.get_auto_login_user().ok();
+                    let existing_username = existing_username
+                        .as_ref()
+                        .map(|username| username.as_bytes());
+                    let details = details.then(|| Details::load(steam, &accounts));
 
-                    match vdf::scan_parse(vdf_source.as_bytes()) {
-                        Ok(document) => match vdf::LoginUser::from_vdf(&document) {
-                            Ok(login_users) => {
-                                let existing_username = Steam::get_auto_login_user().ok();
-                                let existing_username = existing_username
-                                    .as_ref()
-                                    .map(|username| username.as_bytes());
-
-                                login_users.for_each(|user| match user {
-                                    Ok(user) => {
-                                        let selected = Some(user.username) == existing_username;
-                                        println!(
-                                            "{ansi_start}{} {} ({}){ansi_end}",
-                                            if selected { "◼" } else { "◻" },
-                                            user.username.escape_ascii(),
-                                            user.nickname.escape_ascii(),
-                                            ansi_start = if should_color && selected {
-                                                "\u{1B}[32m"
-                                            } else {
-                                                ""
-                                            },
-                                            ansi_end = if should_color { "\u{1B}[0m" } else { "" },
-                                        )
-                                    }
-                                    Err(e) => eprintln!("Failed to read user entry: {e}"),
-                                });
-                            }
-                            Err(e) => {
-                                eprintln!("Failed to parse logged in users data: {e}");
-                                return ExitCode::from(69);
+                    // Formatted into one buffer, to be printed with a single write rather than one per user.
+                    let mut rows =
+                        Vec::with_capacity(accounts.as_bytes().len() + 16 * accounts.len());
+                    for user in accounts.users() {
+                        let selected = Some(user.username) == existing_username;
+                        let _ = writeln!(
+                            rows,
+                            "{ansi_start}{} {} ({}){ansi_end}",
+                            if selected { "◼" } else { "◻" },
+                            user.username.escape_ascii(),
+                            user.nickname.to_string_lossy(),
+                            ansi_start = if should_color && selected {
+                                "\u{1B}[32m"
+                            } else {
+                                ""
+                            },
+                            ansi_end = if should_color { "\u{1B}[0m" } else { "" },
+                        );
+                        let Some(details) = &details else { continue };
+                        rows.extend_from_slice(b"    last login ");
+                        if user.timestamp == 0 {
+                            rows.extend_from_slice(b"unknown");
+                        } else {
+                            rows.extend_from_slice(utc_time(user.timestamp).as_bytes());
+                        }
+                        if user.wants_offline_mode {
+                            rows.extend_from_slice(b", offline mode");
+                        }
+                        if let Some(account) = user.account_id().and_then(|id| details.account(id))
+                        {
+                            let _ = write!(rows, ", {} games played", account.apps);
+                        }
+                        rows.push(b'\n');
+                    }
+                    if let Some(details) = &details {
+                        rows.extend_from_slice(b"Libraries:\n");
+                        for library in &details.libraries {
+                            let _ = write!(rows, "    {}", library.path);
+                            if let Some(apps) = library.apps {
+                                let _ = write!(rows, " ({apps} apps)");
                             }
-                        },
-                        Err(e) => {
-                            eprintln!("Failed to parse logged in users data: {e}");
-                            return ExitCode::from(69);
+                            rows.push(b'\n');
                         }
                     }
+                    let _ = out.write_all(&rows);
+                }
+                Err(e @ diverter::Error::LoginUsersVdf(_)) => {
+                    say!(err, "Failed to parse logged in users data: {e}");
+                    return e.exit_code();
                 }
                 Err(e) => {
-                    eprintln!("Failed to find logged in users data: {e}");
-                    return ExitCode::from(&e);
+                    say!(err, "Failed to find logged in users data: {e}");
+                    return e.exit_code();
                 }
             },
             Err(e) => {
-                eprintln!("Failed to find Steam: {e}");
-                return ExitCode::from(&e);
+                say!(err, "Failed to find Steam: {e}");
+                return e.exit_code();
             }
         },
+        Command::Status { json } => {
+            let steam = match steam(&mut context.steam) {
+                Ok(steam) => steam,
+                Err(e) => {
+                    say!(err, "Failed to find Steam: {e}");
+                    return e.exit_code();
+                }
+            };
+            let status = match &context.tracker {
+                Some(tracker) => steam.status_tracked(tracker),
+                None => steam.status(),
+            };
+            let status = match status {
+                Ok(status) => status,
+                Err(e) => {
+                    say!(err, "Failed to get Steam's status: {e}");
+                    return e.exit_code();
+                }
+            };
+            if json {
+                let accounts = match accounts(steam, context.accounts.as_ref()) {
+                    Ok(accounts) => accounts,
+                    Err(e) => {
+                        say!(err, "Failed to load logged in users data: {e}");
+                        return e.exit_code();
+                    }
+                };
+                say!(out, "{}", snapshot_json(&Snapshot { status, accounts }));
+            } else {
+                say!(
+                    out,
+                    "Steam is {}",
+                    if status.running {
+                        "running"
+                    } else {
+                        "not running"
+                    }
+                );
+                match status.auto_login_user {
+                    Some(username) => say!(out, "Account: {username}"),
+                    None => say!(out, "Account: none"),
+                }
+            }
+        }
+        Command::Serve => {
+            say!(err, "The daemon is already serving this command");
+            return 64;
+        }
+        Command::RunEach {
+            usernames,
+            graceful,
+            smart,
+            deadline,
+            wait,
+            most_recent,
+            command,
+        } => {
+            let steam = match steam(&mut context.steam) {
+                Ok(steam) => steam,
+                Err(e) => {
+                    say!(err, "Failed to find Steam: {e}");
+                    return e.exit_code();
+                }
+            };
+            // Set up once for the whole batch, which a single switch wouldn't make up for.
+            let tracker = match Tracker::new(steam) {
+                Ok(tracker) => Some(tracker),
+                Err(e) => {
+                    say!(
+                        err,
+                        "⚠️ Failed to track Steam's processes, will scan for them instead: {e}"
+                    );
+                    None
+                }
+            };
+            let accounts = match SharedAccounts::load(steam) {
+                Ok(accounts) => Some(accounts),
+                Err(e) => {
+                    say!(err, "⚠️ Failed to load the logged in users data: {e}");
+                    None
+                }
+            };
+            let restart = Restart {
+                graceful,
+                smart,
+                deadline,
+                verify: false,
+                job: true,
+                wait: Some(wait),
+            };
+
+            let start = Instant::now();
+            let mut switching = Duration::ZERO;
+            let mut failed = 0usize;
+            for (i, &username) in usernames.iter().enumerate() {
+                say!(err, "👤 [{}/{}] {username}", i + 1, usernames.len());
+                let switch_start = Instant::now();
+                let code = switch(
+                    steam,
+                    accounts.as_ref(),
+                    tracker.as_ref(),
+                    username,
+                    Some(restart),
+                    most_recent,
+                    err,
+                );
+                switching += switch_start.elapsed();
+                if code != 0 {
+                    failed += 1;
+                    continue;
+                }
+                let Some((program, args)) = command.split_first() else {
+                    continue;
+                };
+                let mut task = process::Command::new(program);
+                task.args(args)
+                    .env("DIVERTER_USERNAME", username.to_string());
+                if let Some(Some(account_id)) =
+                    login_user_account_id(steam, accounts.as_ref(), username)
+                {
+                    task.env("DIVERTER_ACCOUNT_ID", account_id.to_string());
+                }
+                match task.status() {
+                    Ok(status) if status.success() => {}
+                    Ok(status) => {
+                        say!(err, "The command failed for {username} ({status})");
+                        failed += 1;
+                    }
+                    Err(e) => {
+                        say!(err, "Failed to run the command: {e}");
+                        return 69;
+                    }
+                }
+            }
+
+            let elapsed = start.elapsed().as_secs_f64();
+            let count = usernames.len();
+            say!(
+                out,
+                "🏁 {} of {count} accounts done in {elapsed:.1}s: {:.1} accounts per minute, {:.1}s per account of which {:.1}s switching",
+                count - failed,
+                count as f64 * 60.0 / elapsed,
+                elapsed / count as f64,
+                switching.as_secs_f64() / count as f64,
+            );
+            if failed != 0 {
+                return 75;
+            }
+        }
+    }
+
+    0
+}
+
+/// Runs the daemon, serving clients one at a time until it's terminated.
+fn serve() -> u8 {
+    let listener = match pipe::Listener::new() {
+        Ok(listener) => listener,
+        Err(e) => {
+            eprintln!("Failed to start the daemon, is one already running? ({e})");
+            return e.exit_code();
+        }
+    };
+    eprintln!("👂 serving");
+    let mut context = Context::default();
+    match steam(&mut context.steam).and_then(Tracker::new) {
+        Ok(tracker) => context.tracker = Some(tracker),
+        Err(e) => {
+            eprintln!("⚠️ Failed to track Steam's processes, will scan for them instead: {e}")
+        }
+    }
+    match steam(&mut context.steam).and_then(SharedAccounts::watch) {
+        Ok(accounts) => context.accounts = Some(accounts),
+        Err(e) => eprintln!(
+            "⚠️ Failed to watch the logged in users data, will check it on each command instead: {e}"
+        ),
+    }
+    let mut payload = Vec::new();
+    loop {
+        let connection = match listener.accept() {
+            Ok(connection) => connection,
+            Err(e) => {
+                eprintln!("Failed to accept a client: {e}");
+                continue;
+            }
+        };
+        if let Err(e) = serve_client(&connection, &mut context, &mut payload) {
+            eprintln!("Failed to serve a client: {e}");
+        }
+    }
+}
+
+/// Runs a client's command and sends it the output.
+fn serve_client(
+    connection: &Connection,
+    context: &mut Context,
+    payload: &mut Vec<u8>,
+) -> io::Result<()> {
+    if pipe::read_frame(connection, payload)? != FrameKind::Args {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            "expected the command line arguments",
+        ));
+    }
+    let args = payload
+        .split_inclusive(|&b| b == 0)
+        .map(|arg| std::str::from_utf8(arg.strip_suffix(&[0]).unwrap_or(arg)))
+        .collect::<Result<Vec<_>, _>>()
+        .map_err(|e| io::Error::new(io::ErrorKind::InvalidData, e))?;
+
+    // Line-buffered, so that output arrives as it's printed, and interleaves with errors as it would locally.
+    let mut out = LineWriter::new(FrameWriter::new(connection, FrameKind::Stdout));
+    let mut err = LineWriter::new(FrameWriter::new(connection, FrameKind::Stderr));
+    let code = match Cli::try_parse_from(iter::once("diverter").chain(args)) {
+        Ok(Cli {
+            command: Command::RunEach { .. },
+            ..
+        }) => {
+            say!(
+                err,
+                "A batch runs in its own process rather than in the daemon"
+            );
+            64
+        }
+        Ok(cli) => run(cli, context, &mut out, &mut err),
+        Err(e) => {
+            let writer: &mut dyn Write = if e.use_stderr() { &mut err } else { &mut out };
+            let _ = write!(writer, "{e}");
+            e.exit_code() as u8
+        }
+    };
+    out.flush()?;
+    err.flush()?;
+    drop((out, err));
+    pipe::write_frame(connection, FrameKind::Exit, &[code])
+}
+
+/// Passes the command to the daemon and prints its output, returning its exit code.
+fn forward(pipe: File, cli: &Cli, args: &[String]) -> io::Result<u8> {
+    let mut payload = Vec::new();
+    // Whether to color depends on the client's terminal, which the daemon can't tell.
+    if cli.color.is_none() {
+        let color: &[u8] = if atty::is(atty::Stream::Stdout) {
+            b"--color\0true\0"
+        } else {
+            b"--color\0false\0"
+        };
+        payload.extend_from_slice(color);
+    }
+    for arg in args {
+        payload.extend_from_slice(arg.as_bytes());
+        payload.push(0);
+    }
+    pipe::write_frame(&pipe, FrameKind::Args, &payload)?;
+
+    let mut stdout = io::stdout().lock();
+    let mut stderr = io::stderr().lock();
+    loop {
+        match pipe::read_frame(&pipe, &mut payload)? {
+            FrameKind::Stdout => stdout.write_all(&payload)?,
+            FrameKind::Stderr => stderr.write_all(&payload)?,
+            FrameKind::Exit => {
+                stdout.flush()?;
+                return Ok(payload.first().copied().unwrap_or(0));
+            }
+            FrameKind::Args => {
+                return Err(io::Error::new(
+                    io::ErrorKind::InvalidData,
+                    "unexpected arguments from the daemon",
+                ))
+            }
+        }
+    }
+}
+
+fn main() -> ExitCode {
+    let cli = Cli::parse();
+    if let Command::Serve = cli.command {
+        return ExitCode::from(serve());
+    }
+
+    // Arguments that aren't UTF-8 can't be forwarded, though Steam usernames always are.
+    let args = std::env::args_os()
+        .skip(1)
+        .map(|arg| arg.into_string())
+        .collect::<Result<Vec<_>, _>>();
+    // A batch runs its commands in this process, and keeps its own context for the whole batch.
+    let local = cli.local || matches!(cli.command, Command::RunEach { .. });
+    if let (false, Ok(args)) = (local, args) {
+        match pipe::connect(Some(CONNECT_TIMEOUT)) {
+            Ok(Some(pipe)) => {
+                return ExitCode::from(forward(pipe, &cli, &args).unwrap_or_else(|e| {
+                    eprintln!("Lost connection to the daemon: {e}");
+                    69
+                }))
+            }
+            Ok(None) => {}
+            // Running the command locally instead could race the daemon's own switch, so it's left to the user.
+            Err(diverter::Error::Pipe(e)) if e.kind() == io::ErrorKind::TimedOut => {
+                eprintln!("The daemon is busy and didn't take the command within {} seconds, try again or pass --local", CONNECT_TIMEOUT.as_secs());
+                return ExitCode::from(75);
+            }
+            Err(e) => {
+                eprintln!("{e}, pass --local to run the command without the daemon");
+                return ExitCode::from(e.exit_code());
+            }
+        }
     }
 
-    ExitCode::SUCCESS
+    let code = run(
+        cli,
+        &mut Context::default(),
+        &mut io::stdout().lock(),
+        &mut io::stderr().lock(),
+    );
+    ExitCode::from(code)
 }
@@ -0,0 +1,191 @@
+//! The named pipe that `diverter serve` listens on, and the framing of the messages over it.
+//!
+//! A client sends its command line in an [`Args`](FrameKind::Args) frame, and the daemon streams back the command's
+//! output in [`Stdout`](FrameKind::Stdout) and [`Stderr`](FrameKind::Stderr) frames, ending with an
+//! [`Exit`](FrameKind::Exit) frame that holds the exit code.
+
+use std::{
+    fs::File,
+    io::{self, Read, Write},
+    os::windows::prelude::{AsRawHandle, FromRawHandle, RawHandle},
+    time::Duration,
+};
+
+use winapi::shared::minwindef::DWORD;
+
+use crate::steam::{err_opt, timeout_ms, CResult, Result};
+
+/// Windows' `INVALID_HANDLE_VALUE`.
+const INVALID_HANDLE_VALUE: RawHandle = -1isize as RawHandle;
+
+/// The maximum payload length of a frame, which guards against bogus lengths.
+const MAX_FRAME_LEN: usize = 1 << 24;
+
+/// The kind of a frame.
+#[repr(u8)]
+#[derive(Debug, Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
+pub enum FrameKind {
+    /// The command's exit code, as a single byte. Ends the response.
+    Exit = 0,
+    /// Part of the command's standard output.
+    Stdout = 1,
+    /// Part of the command's standard error.
+    Stderr = 2,
+    /// The command line arguments, excluding the program name, each terminated by a NUL.
+    Args = 3,
+}
+
+impl TryFrom<u8> for FrameKind {
+    type Error = io::Error;
+
+    fn try_from(kind: u8) -> io::Result<Self> {
+        Ok(match kind {
+            0 => Self::Exit,
+            1 => Self::Stdout,
+            2 => Self::Stderr,
+            3 => Self::Args,
+            _ => {
+                return Err(io::Error::new(
+                    io::ErrorKind::InvalidData,
+                    "unknown frame kind",
+                ))
+            }
+        })
+    }
+}
+
+/// Writes a frame, which is its kind, its payload's length as a little-endian `u32`, and its payload.
+pub fn write_frame(mut writer: impl Write, kind: FrameKind, payload: &[u8]) -> io::Result<()> {
+    if payload.len() > MAX_FRAME_LEN {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidInput,
+            "frame too long",
+        ));
+    }
+    // Written at once, since each write to a pipe is a system call.
+    let mut frame = Vec::with_capacity(5 + payload.len());
+    frame.push(kind as u8);
+    frame.extend_from_slice(&(payload.len() as u32).to_le_bytes());
+    frame.extend_from_slice(payload);
+    writer.write_all(&frame)
+}
+
+/// Reads a frame into the payload buffer, replacing its contents, and returns the frame's kind.
+pub fn read_frame(mut reader: impl Read, payload: &mut Vec<u8>) -> io::Result<FrameKind> {
+    let mut header = [0; 5];
+    reader.read_exact(&mut header)?;
+    let kind = FrameKind::try_from(header[0])?;
+    let len = u32::from_le_bytes([header[1], header[2], header[3], header[4]]) as usize;
+    if len > MAX_FRAME_LEN {
+        return Err(io::Error::new(io::ErrorKind::InvalidData, "frame too long"));
+    }
+    payload.clear();
+    payload.resize(len, 0);
+    reader.read_exact(payload)?;
+    Ok(kind)
+}
+
+/// A [writer](Write) that writes each write as a frame of the given kind.
+///
+/// Wrap it in a [`LineWriter`](io::LineWriter) to frame output by line.
+#[derive(Debug)]
+pub struct FrameWriter<W> {
+    inner: W,
+    kind: FrameKind,
+}
+
+impl<W: Write> FrameWriter<W> {
+    /// Creates a new [`FrameWriter`].
+    #[inline]
+    pub const fn new(inner: W, kind: FrameKind) -> Self {
+        Self { inner, kind }
+    }
+}
+
+impl<W: Write> Write for FrameWriter<W> {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let len = buf.len().min(MAX_FRAME_LEN);
+        write_frame(&mut self.inner, self.kind, &buf[..len])?;
+        Ok(len)
+    }
+
+    #[inline]
+    fn flush(&mut self) -> io::Result<()> {
+        self.inner.flush()
+    }
+}
+
+/// The daemon's end of the pipe.
+#[derive(Debug)]
+pub struct Listener(File);
+
+impl Listener {
+    /// Creates the pipe, failing if another daemon already has it.
+    pub fn new() -> Result<Self> {
+        let mut pipe = INVALID_HANDLE_VALUE;
+        err_opt(unsafe { steam_pipe_create(&mut pipe) }.into(), ())?;
+        Ok(Self(unsafe { File::from_raw_handle(pipe) }))
+    }
+
+    /// Waits for a client to connect.
+    pub fn accept(&self) -> Result<Connection<'_>> {
+        err_opt(
+            unsafe { steam_pipe_accept(self.0.as_raw_handle()) }.into(),
+            Connection(&self.0),
+        )
+    }
+}
+
+/// A client's connection to the [`Listener`], which is disconnected on drop.
+#[derive(Debug)]
+pub struct Connection<'a>(&'a File);
+
+impl Read for &Connection<'_> {
+    #[inline]
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let mut file = self.0;
+        file.read(buf)
+    }
+}
+
+impl Write for &Connection<'_> {
+    #[inline]
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let mut file = self.0;
+        file.write(buf)
+    }
+
+    #[inline]
+    fn flush(&mut self) -> io::Result<()> {
+        let mut file = self.0;
+        file.flush()
+    }
+}
+
+impl Drop for Connection<'_> {
+    #[inline]
+    fn drop(&mut self) {
+        unsafe { steam_pipe_disconnect(self.0.as_raw_handle()) }
+    }
+}
+
+/// Connects to the daemon, waiting up to the timeout while it serves other clients.
+///
+/// Returns [`None`] if no daemon is running, and fails with a [`PermissionDenied`](io::ErrorKind::PermissionDenied)
+/// [`Error::Pipe`](crate::Error::Pipe) if the pipe's server runs as another user.
+pub fn connect(timeout: Option<Duration>) -> Result<Option<File>> {
+    let mut pipe = INVALID_HANDLE_VALUE;
+    err_opt(
+        unsafe { steam_pipe_connect(&mut pipe, timeout_ms(timeout)) }.into(),
+        (),
+    )?;
+    Ok((pipe != INVALID_HANDLE_VALUE).then(|| unsafe { File::from_raw_handle(pipe) }))
+}
+
+#[link(name = "windowsutil")]
+extern "C" {
+    fn steam_pipe_create(pipe: *mut RawHandle) -> CResult;
+    fn steam_pipe_accept(pipe: RawHandle) -> CResult;
+    fn steam_pipe_disconnect(pipe: RawHandle);
+    fn steam_pipe_connect(pipe: *mut RawHandle, timeout_ms: DWORD) -> CResult;
+}
@@ -0,0 +1,145 @@
+//! Where Steam operations spend their time, to tell what makes a switch slow.
+
+use std::{
+    sync::atomic::{AtomicU32, AtomicU64, Ordering},
+    time::{Duration, Instant},
+};
+
+use crate::steam::CPhase;
+
+/// Reflects `windows.c`'s `PHASE_COUNT`.
+const PHASE_COUNT: usize = CPhase::Watch as usize + 1;
+
+/// Reflects `windows.c`'s `steam_stats_t`.
+#[repr(C)]
+#[derive(Debug, Default)]
+struct CStats {
+    ticks: [i64; PHASE_COUNT],
+    calls: [i32; PHASE_COUNT],
+    processes_scanned: i32,
+    processes_opened: i32,
+    processes_terminated: i32,
+}
+
+/// The time spent parsing VDF, in nanoseconds, which is measured here since parsing isn't done in `windows.c`.
+static PARSE_NANOS: AtomicU64 = AtomicU64::new(0);
+/// The number of VDF parses.
+static PARSE_CALLS: AtomicU32 = AtomicU32::new(0);
+
+/// Times a VDF parse, for [`Timings::parse_vdf`].
+pub(crate) fn time_parse<T>(parse: impl FnOnce() -> T) -> T {
+    let start = Instant::now();
+    let result = parse();
+    PARSE_NANOS.fetch_add(start.elapsed().as_nanos() as u64, Ordering::Relaxed);
+    PARSE_CALLS.fetch_add(1, Ordering::Relaxed);
+    result
+}
+
+/// The time spent in a phase, and the number of operations that took it.
+#[derive(Debug, Default, Hash, Clone, Copy, PartialEq, Eq)]
+pub struct PhaseTiming {
+    /// The time spent.
+    pub time: Duration,
+    /// The number of operations, e.g. the system calls in the phase or the VDF files parsed.
+    pub count: u32,
+}
+
+/// Where Steam operations spent their time, and how much work they did, see [`Timings::take`].
+///
+/// A phase's time is that of the system calls that do its work, so the phases don't overlap.
+#[derive(Debug, Default, Hash, Clone, Copy, PartialEq, Eq)]
+pub struct Timings {
+    /// Reading Steam's registry key, including opening it.
+    pub read_registry: PhaseTiming,
+    /// Writing Steam's registry key.
+    pub write_registry: PhaseTiming,
+    /// Creating Steam's process, or its shutdown helper's.
+    pub launch: PhaseTiming,
+    /// Waiting for Steam's processes to exit.
+    pub wait_exit: PhaseTiming,
+    /// Snapshotting the system's processes, and opening them to check whether they're Steam's.
+    pub enum_processes: PhaseTiming,
+    /// Terminating Steam's processes.
+    pub kill: PhaseTiming,
+    /// Opening VDF files.
+    pub open_vdf: PhaseTiming,
+    /// Mapping or reading VDF files.
+    pub read_vdf: PhaseTiming,
+    /// Parsing VDF files.
+    pub parse_vdf: PhaseTiming,
+    /// Writing VDF files.
+    pub write_vdf: PhaseTiming,
+    /// Waiting for Steam to log in.
+    pub wait_login: PhaseTiming,
+    /// The processes looked at in snapshots of the system's processes.
+    pub processes_scanned: u32,
+    /// The processes opened, to check whether they're Steam's or to wait on them.
+    pub processes_opened: u32,
+    /// The processes terminated.
+    pub processes_terminated: u32,
+}
+
+impl Timings {
+    /// Takes the timings since the last take, starting them over.
+    ///
+    /// The timings are of the whole process, including the work of a [`Tracker`](crate::Tracker) or a
+    /// [`SharedAccounts`](crate::SharedAccounts) watcher in the background.
+    pub fn take() -> Self {
+        let mut stats = CStats::default();
+        let mut frequency = 0i64;
+        unsafe { steam_stats_take(&mut stats, &mut frequency) };
+        let phase = |phase: CPhase| PhaseTiming {
+            time: ticks_duration(stats.ticks[phase as usize], frequency),
+            count: stats.calls[phase as usize] as u32,
+        };
+        Self {
+            read_registry: phase(CPhase::ReadSteamRegistry),
+            write_registry: phase(CPhase::WriteSteamRegistry),
+            launch: phase(CPhase::LaunchSteam),
+            wait_exit: phase(CPhase::WaitSteamExit),
+            enum_processes: phase(CPhase::EnumProcesses),
+            kill: phase(CPhase::KillSteam),
+            open_vdf: phase(CPhase::FileOpenVdf),
+            read_vdf: phase(CPhase::ReadVdf),
+            parse_vdf: PhaseTiming {
+                time: Duration::from_nanos(PARSE_NANOS.swap(0, Ordering::Relaxed)),
+                count: PARSE_CALLS.swap(0, Ordering::Relaxed),
+            },
+            write_vdf: phase(CPhase::WriteVdf),
+            wait_login: phase(CPhase::WaitSteamLogin),
+            processes_scanned: stats.processes_scanned as u32,
+            processes_opened: stats.processes_opened as u32,
+            processes_terminated: stats.processes_terminated as u32,
+        }
+    }
+
+    /// The phases by name, in the order a switch goes through them.
+    pub fn phases(&self) -> [(&'static str, PhaseTiming); 11] {
+        [
+            ("read_registry", self.read_registry),
+            ("open_vdf", self.open_vdf),
+            ("read_vdf", self.read_vdf),
+            ("parse_vdf", self.parse_vdf),
+            ("enum_processes", self.enum_processes),
+            ("kill", self.kill),
+            ("wait_exit", self.wait_exit),
+            ("write_registry", self.write_registry),
+            ("write_vdf", self.write_vdf),
+            ("launch", self.launch),
+            ("wait_login", self.wait_login),
+        ]
+    }
+}
+
+/// Converts `QueryPerformanceCounter` ticks to a [`Duration`].
+fn ticks_duration(ticks: i64, frequency: i64) -> Duration {
+    if ticks <= 0 || frequency <= 0 {
+        return Duration::ZERO;
+    }
+    Duration::from_nanos((ticks as u128 * 1_000_000_000 / frequency as u128) as u64)
+}
+
+#[link(name = "windowsutil")]
+extern "C" {
+    fn steam_stats_take(stats: *mut CStats, frequency: *mut i64);
+}
@@ -1,29 +1,46 @@
 //! Steam client operations.
 
 use std::{
-    ffi::c_char,
+    ffi::{c_char, OsStr},
     fmt::Debug,
     fs::File,
     io,
     mem::MaybeUninit,
-    os::windows::prelude::{FromRawHandle, OsStringExt, RawHandle},
+    ops::Deref,
+    os::windows::prelude::{AsRawHandle, FromRawHandle, OsStrExt, OsStringExt, RawHandle},
     process::ExitCode,
-    time::Duration,
+    sync::Arc,
+    time::{Duration, Instant},
 };
 
 use winapi::{
     ctypes::wchar_t,
-    shared::minwindef::{DWORD, MAX_PATH},
+    shared::minwindef::{DWORD, HKEY, MAX_PATH},
 };
 
-use crate::{Username, UsernameError};
+use crate::{
+    vdf::{self, LoginUserVdfError},
+    AccountIndex, Tracker, Username, UsernameError,
+};
 
 #[repr(C)]
-#[derive(Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
 /// A handle to the installed Steam client.
 pub struct Steam {
     len: wchar_t,
     path: [wchar_t; MAX_PATH],
+    /// Steam's registry key, kept open for the lifetime of the handle.
+    key: HKEY,
+}
+
+// SAFETY: the registry key handle can be used from any thread, and is only closed on drop.
+unsafe impl Send for Steam {}
+unsafe impl Sync for Steam {}
+
+impl Drop for Steam {
+    #[inline]
+    fn drop(&mut self) {
+        unsafe { steam_free(self) }
+    }
 }
 
 impl Debug for Steam {
@@ -40,7 +57,7 @@ impl Debug for Steam {
 #[repr(C)]
 #[derive(Debug, PartialEq, Eq, Clone, Copy)]
 #[allow(dead_code)]
-enum CPhase {
+pub(crate) enum CPhase {
     Ok = 0,
     ReadSteamRegistry = 1,
     WriteSteamRegistry,
@@ -49,12 +66,17 @@ enum CPhase {
     EnumProcesses,
     KillSteam,
     FileOpenVdf,
+    WaitSteamLogin,
+    ReadVdf,
+    WriteVdf,
+    Pipe,
+    Watch,
 }
 
 /// Reflects `windows.c`'s `result_t`.
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
-struct CResult {
+pub(crate) struct CResult {
     phase: CPhase,
     win_code: DWORD,
 }
@@ -87,15 +109,41 @@ pub enum Error {
     /// Indicates failure to open a VDF file.
     #[error("failed to open a VDF file: {0}")]
     VdfOpen(io::Error),
+    /// Indicates failure while waiting for Steam to log in.
+    #[error("failed to wait for Steam to log in: {0}")]
+    WaitSteamLogin(io::Error),
+    /// Indicates failure to read a VDF file.
+    #[error("failed to read a VDF file: {0}")]
+    VdfRead(io::Error),
+    /// Indicates that loginusers.vdf is malformed.
+    #[error("failed to parse loginusers.vdf: {0}")]
+    LoginUsersVdf(LoginUserVdfError),
+    /// Indicates failure to write a VDF file.
+    #[error("failed to write a VDF file: {0}")]
+    VdfWrite(io::Error),
+    /// Indicates failure to communicate over the daemon's pipe.
+    #[error("failed to communicate with the diverter daemon: {0}")]
+    Pipe(io::Error),
+    /// Indicates failure to watch Steam's files for changes.
+    #[error("failed to watch Steam's files: {0}")]
+    Watch(io::Error),
+}
+
+impl Error {
+    /// The error's exit code, per `sysexits.h`.
+    pub fn exit_code(&self) -> u8 {
+        match self {
+            Error::InvalidUsernameInRegistry(_) => 78,
+            _ => 69,
+        }
+    }
 }
 
 /// Exit codes per `sysexits.h`.
 impl<'a> From<&'a Error> for ExitCode {
+    #[inline]
     fn from(e: &'a Error) -> Self {
-        ExitCode::from(match e {
-            Error::InvalidUsernameInRegistry(_) => 78,
-            _ => 69,
-        })
+        ExitCode::from(e.exit_code())
     }
 }
 
@@ -125,28 +173,168 @@ impl From<CResult> for Option<Error> {
             CPhase::FileOpenVdf => Some(Error::VdfOpen(io::Error::from_raw_os_error(
                 value.win_code as _,
             ))),
+            CPhase::WaitSteamLogin => Some(Error::WaitSteamLogin(io::Error::from_raw_os_error(
+                value.win_code as _,
+            ))),
+            CPhase::ReadVdf => Some(Error::VdfRead(io::Error::from_raw_os_error(
+                value.win_code as _,
+            ))),
+            CPhase::WriteVdf => Some(Error::VdfWrite(io::Error::from_raw_os_error(
+                value.win_code as _,
+            ))),
+            CPhase::Pipe => Some(Error::Pipe(io::Error::from_raw_os_error(
+                value.win_code as _,
+            ))),
+            CPhase::Watch => Some(Error::Watch(io::Error::from_raw_os_error(
+                value.win_code as _,
+            ))),
+        }
+    }
+}
+
+/// Reflects `windows.c`'s `handles_t`.
+#[repr(C)]
+#[derive(Debug)]
+struct CHandles {
+    handles: *mut RawHandle,
+    len: usize,
+    capacity: usize,
+}
+
+impl Default for CHandles {
+    #[inline]
+    fn default() -> Self {
+        Self {
+            handles: std::ptr::null_mut(),
+            len: 0,
+            capacity: 0,
         }
     }
 }
 
+/// A read-only view of a file's contents, see [`Steam::map_file`].
+///
+/// Reflects `windows.c`'s `steam_view_t`.
+#[repr(C)]
+pub struct FileView {
+    data: *const u8,
+    len: usize,
+    mapped: u8,
+}
+
+// SAFETY: the view is read-only and only released on drop.
+unsafe impl Send for FileView {}
+unsafe impl Sync for FileView {}
+
+impl Deref for FileView {
+    type Target = [u8];
+
+    #[inline]
+    fn deref(&self) -> &[u8] {
+        // SAFETY: steam_file_map always yields a valid (possibly empty) view
+        unsafe { std::slice::from_raw_parts(self.data, self.len) }
+    }
+}
+
+impl Drop for FileView {
+    #[inline]
+    fn drop(&mut self) {
+        unsafe { steam_view_free(self) }
+    }
+}
+
+impl Debug for FileView {
+    #[inline]
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("FileView")
+            .field("len", &self.len)
+            .field("mapped", &(self.mapped != 0))
+            .finish()
+    }
+}
+
+/// Identifies a version of a file, which changes when the file is written to or replaced.
+///
+/// Reflects `windows.c`'s `file_identity_t`.
+#[repr(C)]
+#[derive(Debug, Hash, Default, Clone, Copy, PartialEq, Eq)]
+pub struct FileIdentity {
+    /// The file's size.
+    pub size: u64,
+    /// The file's last write time, as a `FILETIME`.
+    pub write_time: u64,
+    /// The file's index on its volume.
+    pub index: u64,
+    /// The serial number of the file's volume.
+    pub volume: u32,
+}
+
+impl FileIdentity {
+    /// Gets the identity of an open file.
+    pub fn of(file: &File) -> Result<Self> {
+        let mut identity = Self::default();
+        err_opt(
+            unsafe { steam_file_identity(file.as_raw_handle(), &mut identity) }.into(),
+            identity,
+        )
+    }
+}
+
 #[link(name = "windowsutil")]
 extern "C" {
     fn steam_init(steam: *mut Steam) -> CResult;
+    fn steam_free(steam: *mut Steam);
     fn steam_shutdown(steam: *const Steam) -> CResult;
+    fn steam_shutdown_start(steam: *const Steam, helper: *mut CHandles) -> CResult;
     fn steam_launch(steam: *const Steam) -> CResult;
     fn steam_launch_fast(steam: *const Steam) -> CResult;
-    fn steam_kill(steam: *const Steam, killed: *mut u8) -> CResult;
-    fn steam_set_auto_login_user(username: *const c_char, username_len: usize) -> CResult;
-    fn steam_get_auto_login_user(username: *mut c_char, username_len: *mut usize) -> CResult;
+    fn steam_launch_job(steam: *const Steam, verify: u8) -> CResult;
+    fn steam_kill(
+        steam: *const Steam,
+        timeout_ms: DWORD,
+        killed: *mut u8,
+        exited: *mut u8,
+    ) -> CResult;
+    fn steam_kill_start(steam: *const Steam, exiting: *mut CHandles, killed: *mut u8) -> CResult;
+    fn steam_handles_wait(handles: *const CHandles, timeout_ms: DWORD, done: *mut u8) -> CResult;
+    fn steam_handles_free(handles: *mut CHandles);
+    fn steam_set_auto_login_user(
+        steam: *const Steam,
+        username: *const c_char,
+        username_len: usize,
+    ) -> CResult;
+    fn steam_get_auto_login_user(
+        steam: *const Steam,
+        username: *mut c_char,
+        username_len: *mut usize,
+    ) -> CResult;
     fn steam_is_running(steam: *const Steam, is_running: *mut u8) -> CResult;
+    fn steam_get_active_user(steam: *const Steam, active_user: *mut DWORD) -> CResult;
+    fn steam_wait_exit(steam: *const Steam, timeout_ms: DWORD, exited: *mut u8) -> CResult;
+    fn steam_wait_login(
+        steam: *const Steam,
+        account_id: DWORD,
+        timeout_ms: DWORD,
+        active_user: *mut DWORD,
+    ) -> CResult;
     fn steam_vdf_loginusers(steam: *const Steam, file: *mut RawHandle) -> CResult;
+    fn steam_file_map(steam: *const Steam, subpath: *const wchar_t, view: *mut FileView)
+        -> CResult;
+    fn steam_view_free(view: *mut FileView);
+    fn steam_file_identity(file: RawHandle, identity: *mut FileIdentity) -> CResult;
+    fn steam_file_replace(
+        steam: *const Steam,
+        subpath: *const wchar_t,
+        data: *const u8,
+        len: usize,
+    ) -> CResult;
 }
 
 /// Converts an error [`Option`] into a [`Result`](::std::result::Result).
 ///
 /// - [`Some(error)`](Some) yield [`Err(error)`](Err).
 /// - [`None`] yields [`Ok(value)`](Ok) where value is the given `value` argument.
-fn err_opt<T, E>(error: Option<E>, value: T) -> ::std::result::Result<T, E> {
+pub(crate) fn err_opt<T, E>(error: Option<E>, value: T) -> ::std::result::Result<T, E> {
     if let Some(e) = error {
         Err(e)
     } else {
@@ -154,9 +342,121 @@ fn err_opt<T, E>(error: Option<E>, value: T) -> ::std::result::Result<T, E> {
     }
 }
 
+/// Windows' `INFINITE` timeout.
+const INFINITE: DWORD = 0xFFFFFFFF;
+
+/// Converts an optional timeout to milliseconds, where [`None`] is [`INFINITE`].
+pub(crate) fn timeout_ms(timeout: Option<Duration>) -> DWORD {
+    timeout.map_or(INFINITE, |timeout| {
+        timeout.as_millis().min((INFINITE - 1) as u128) as DWORD
+    })
+}
+
 /// A [`Steam`] [`Result`](::std::result::Result) type.
 pub type Result<T> = ::std::result::Result<T, Error>;
 
+/// Steam exiting in the background, see [`Steam::start_shutdown`] and [`Steam::start_kill`].
+#[must_use = "Steam may still be running until its exit is waited on"]
+pub struct PendingExit<'a> {
+    steam: &'a Steam,
+    handles: CHandles,
+    /// Whether Steam is being killed, in which case processes that spawn meanwhile are killed too.
+    kill: bool,
+    /// Tracks the processes that are waited on, instead of scanning for them.
+    tracker: Option<&'a Tracker>,
+}
+
+impl<'a> PendingExit<'a> {
+    /// Checks if there's nothing to wait on, e.g. when Steam wasn't running to be killed.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.handles.len == 0
+    }
+
+    /// Waits on the tracker's processes rather than scanning for them, when Steam is shut down.
+    ///
+    /// Killing Steam still scans, to kill processes that spawn meanwhile.
+    #[inline]
+    pub fn tracked(mut self, tracker: &'a Tracker) -> Self {
+        self.tracker = Some(tracker);
+        self
+    }
+
+    /// Waits until Steam exits.
+    ///
+    /// Returns whether Steam has exited before the timeout ([`None`] waits indefinitely).
+    pub fn wait(self, timeout: Option<Duration>) -> Result<bool> {
+        let start = Instant::now();
+        let mut done = 0u8;
+        err_opt(
+            unsafe { steam_handles_wait(&self.handles, timeout_ms(timeout), &mut done) }.into(),
+            (),
+        )?;
+        if done == 0 {
+            return Ok(false);
+        }
+        let remaining = timeout.map(|timeout| timeout.saturating_sub(start.elapsed()));
+        match self.tracker {
+            _ if self.kill => self.steam.kill_confirm(remaining).map(|(_, exited)| exited),
+            Some(tracker) => tracker.wait_exit(remaining),
+            None => self.steam.wait_exit(remaining),
+        }
+    }
+
+    /// Waits until Steam exits, and kills it if it's still running after the deadline.
+    ///
+    /// Returns whether Steam had to be killed.
+    /// See [`Steam::kill`] for `kill_timeout`.
+    pub fn wait_or_kill(self, deadline: Duration, kill_timeout: Option<Duration>) -> Result<bool> {
+        let steam = self.steam;
+        if self.wait(Some(deadline))? {
+            Ok(false)
+        } else {
+            steam.kill(kill_timeout).map(|_| true)
+        }
+    }
+}
+
+impl<'a> Drop for PendingExit<'a> {
+    #[inline]
+    fn drop(&mut self) {
+        unsafe { steam_handles_free(&mut self.handles) }
+    }
+}
+
+impl<'a> Debug for PendingExit<'a> {
+    #[inline]
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("PendingExit")
+            .field("handles", &self.handles.len)
+            .finish()
+    }
+}
+
+/// The state of the Steam client at a point in time, see [`Steam::status`].
+#[derive(Debug, Clone, Copy)]
+pub struct Status {
+    /// The user Steam will attempt to automatically log into, unless it's unset or invalid.
+    pub auto_login_user: Option<Username>,
+    /// Whether the Steam client is running.
+    pub running: bool,
+    /// The account ID that Steam reports as logged in, while it's running.
+    ///
+    /// See [`LoginUser::account_id`](crate::vdf::LoginUser::account_id).
+    pub active_user: Option<u32>,
+}
+
+/// The [`Status`] of the Steam client along with its [accounts](AccountIndex), see [`Steam::snapshot`].
+///
+/// The accounts are shared, so snapshots are cheap to clone.
+#[derive(Debug, Clone)]
+pub struct Snapshot {
+    /// The client's status.
+    pub status: Status,
+    /// The accounts that have logged in to Steam on this machine.
+    pub accounts: Arc<AccountIndex>,
+}
+
 impl Steam {
     /// Attempts to create a new [`Steam`] handle.
     #[inline]
@@ -164,26 +464,72 @@ impl Steam {
         let mut steam = Steam {
             len: 0,
             path: [0; MAX_PATH],
+            key: std::ptr::null_mut(),
         };
         err_opt(unsafe { steam_init(&mut steam) }.into(), steam)
     }
 
     /// Gracefully and asynchronously shuts down Steam, if running.
     #[inline]
-    pub fn start_shutdown(&self) -> Result<()> {
-        err_opt(unsafe { steam_shutdown(self) }.into(), ())
+    pub fn start_shutdown(&self) -> Result<PendingExit<'_>> {
+        let mut exit = PendingExit {
+            steam: self,
+            handles: CHandles::default(),
+            kill: false,
+            tracker: None,
+        };
+        err_opt(
+            unsafe { steam_shutdown_start(self, &mut exit.handles) }.into(),
+            exit,
+        )
     }
 
     /// Gracefully shuts down Steam, if running, and polls until all Steam processes are shut down.
     #[inline]
     pub fn shutdown_poll(&self, poll: Duration) -> Result<()> {
-        self.start_shutdown()?;
+        err_opt(unsafe { steam_shutdown(self) }.into(), ())?;
         while self.is_running()? {
             std::thread::sleep(poll)
         }
         Ok(())
     }
 
+    /// Gracefully shuts down Steam, if running, and waits until all Steam processes exit.
+    ///
+    /// Returns whether Steam has exited before the timeout ([`None`] waits indefinitely).
+    #[inline]
+    pub fn shutdown_wait(&self, timeout: Option<Duration>) -> Result<bool> {
+        self.start_shutdown()?.wait(timeout)
+    }
+
+    /// Gracefully shuts down Steam, if running, and kills it if it's still running after the deadline.
+    ///
+    /// Returns whether Steam had to be killed.
+    /// See [`Steam::kill`] for `kill_timeout`.
+    #[inline]
+    pub fn shutdown_or_kill(
+        &self,
+        deadline: Duration,
+        kill_timeout: Option<Duration>,
+    ) -> Result<bool> {
+        match self.start_shutdown() {
+            Ok(shutdown) => shutdown.wait_or_kill(deadline, kill_timeout),
+            Err(_) => self.kill(kill_timeout).map(|_| true),
+        }
+    }
+
+    /// Waits until all Steam processes exit, without polling.
+    ///
+    /// Returns whether Steam has exited before the timeout ([`None`] waits indefinitely).
+    #[inline]
+    pub fn wait_exit(&self, timeout: Option<Duration>) -> Result<bool> {
+        let mut exited = 0u8;
+        err_opt(
+            unsafe { steam_wait_exit(self, timeout_ms(timeout), &mut exited) }.into(),
+            exited != 0,
+        )
+    }
+
     /// Launches Steam.
     ///
     /// See also: [`Self::launch_fast`].
@@ -198,33 +544,77 @@ impl Steam {
         err_opt(unsafe { steam_launch_fast(self) }.into(), ())
     }
 
-    /// Kills all Steam processes.
+    /// Launches Steam inside a job object, optionally skipping Steam's file checks.
+    ///
+    /// While Steam runs in the job, [`Self::kill`] and [`Self::is_running`] use the job instead of scanning the system's processes.
+    #[inline]
+    pub fn launch_in_job(&self, verify: bool) -> Result<()> {
+        err_opt(unsafe { steam_launch_job(self, verify as u8) }.into(), ())
+    }
+
+    /// Kills all Steam processes and waits until they exit ([`None`] waits indefinitely).
     ///
     /// Returns whether any were found and killed.
+    /// If some are still running when the timeout elapses, it fails with [`Error::KillSteam`].
+    #[inline]
+    pub fn kill(&self, timeout: Option<Duration>) -> Result<bool> {
+        let (killed, exited) = self.kill_confirm(timeout)?;
+        if exited {
+            Ok(killed)
+        } else {
+            Err(Error::KillSteam(io::ErrorKind::TimedOut.into()))
+        }
+    }
+
+    /// Kills all Steam processes and waits until they exit.
+    ///
+    /// Returns whether any were found and killed, and whether they all exited before the timeout.
+    fn kill_confirm(&self, timeout: Option<Duration>) -> Result<(bool, bool)> {
+        let mut killed = 0u8;
+        let mut exited = 0u8;
+        err_opt(
+            unsafe { steam_kill(self, timeout_ms(timeout), &mut killed, &mut exited) }.into(),
+            (killed != 0, exited != 0),
+        )
+    }
+
+    /// Kills all Steam processes without waiting for them to exit.
     #[inline]
-    pub fn kill(&self) -> Result<bool> {
+    pub fn start_kill(&self) -> Result<PendingExit<'_>> {
+        let mut exit = PendingExit {
+            steam: self,
+            handles: CHandles::default(),
+            kill: true,
+            tracker: None,
+        };
         let mut killed = 0u8;
-        err_opt(unsafe { steam_kill(self, &mut killed) }.into(), killed != 0)
+        err_opt(
+            unsafe { steam_kill_start(self, &mut exit.handles, &mut killed) }.into(),
+            exit,
+        )
     }
 
     /// Sets the Steam user that Steam will attempt to automatically log into.
     #[inline]
-    pub fn set_auto_login_user(username: Username) -> Result<()> {
+    pub fn set_auto_login_user(&self, username: Username) -> Result<()> {
         let username = username.as_bytes_with_nul();
         err_opt(
-            unsafe { steam_set_auto_login_user(username.as_ptr() as *const i8, username.len()) }
-                .into(),
+            unsafe {
+                steam_set_auto_login_user(self, username.as_ptr() as *const i8, username.len())
+            }
+            .into(),
             (),
         )
     }
 
     /// Gets the Steam user that Steam will attempt to automatically log into.
     #[inline]
-    pub fn get_auto_login_user() -> Result<Username> {
+    pub fn get_auto_login_user(&self) -> Result<Username> {
         let mut data = [MaybeUninit::<u8>::uninit(); Username::MAX_LEN + 1];
         let mut len = data.len();
         err_opt(
-            (unsafe { steam_get_auto_login_user(data.as_mut_ptr() as *mut i8, &mut len) }).into(),
+            (unsafe { steam_get_auto_login_user(self, data.as_mut_ptr() as *mut i8, &mut len) })
+                .into(),
             (),
         )?;
         let username = unsafe { std::slice::from_raw_parts(data.as_ptr() as *const u8, len - 1) };
@@ -241,6 +631,88 @@ impl Steam {
         )
     }
 
+    /// Gets the account ID that Steam reports as logged in, or [`None`] if no account is.
+    ///
+    /// Steam may not clear it when it's killed, so check that it's [running](Self::is_running) as well.
+    #[inline]
+    pub fn get_active_user(&self) -> Result<Option<u32>> {
+        let mut active_user: DWORD = 0;
+        err_opt(
+            unsafe { steam_get_active_user(self, &mut active_user) }.into(),
+            (active_user != 0).then_some(active_user),
+        )
+    }
+
+    /// Gets the state of the client.
+    ///
+    /// The registry values are read off the handle's open key, and checking whether Steam is running scans the
+    /// system's processes at most once.
+    #[inline]
+    pub fn status(&self) -> Result<Status> {
+        self.status_running(self.is_running()?)
+    }
+
+    /// Gets the state of the client, see [`Self::status`], checking whether Steam is running with the tracker.
+    #[inline]
+    pub fn status_tracked(&self, tracker: &Tracker) -> Result<Status> {
+        self.status_running(tracker.is_running()?)
+    }
+
+    fn status_running(&self, running: bool) -> Result<Status> {
+        let auto_login_user = match self.get_auto_login_user() {
+            Ok(username) => Some(username),
+            Err(Error::InvalidUsernameInRegistry(_)) => None,
+            Err(Error::ReadSteamRegistry(e)) if e.kind() == io::ErrorKind::NotFound => None,
+            Err(e) => return Err(e),
+        };
+        let active_user = if running {
+            self.get_active_user()?
+        } else {
+            None
+        };
+        Ok(Status {
+            auto_login_user,
+            running,
+            active_user,
+        })
+    }
+
+    /// Gets the [`Status`] of the client along with its accounts, which are [loaded](AccountIndex::load) from a
+    /// single parse of `loginusers.vdf` at most.
+    pub fn snapshot(&self) -> Result<Snapshot> {
+        Ok(Snapshot {
+            status: self.status()?,
+            accounts: Arc::new(AccountIndex::load(self)?),
+        })
+    }
+
+    /// Waits until Steam logs in, without polling.
+    ///
+    /// `account_id` is the account to wait for (see [`LoginUser::account_id`](crate::vdf::LoginUser::account_id)),
+    /// or [`None`] for any account.
+    ///
+    /// Returns the logged in account ID, or [`None`] if the timeout elapsed first ([`None`] waits indefinitely).
+    #[inline]
+    pub fn wait_login(
+        &self,
+        account_id: Option<u32>,
+        timeout: Option<Duration>,
+    ) -> Result<Option<u32>> {
+        let mut active_user: DWORD = 0;
+        err_opt(
+            unsafe {
+                steam_wait_login(
+                    self,
+                    account_id.unwrap_or(0),
+                    timeout_ms(timeout),
+                    &mut active_user,
+                )
+            }
+            .into(),
+            (active_user != 0).then_some(active_user),
+        )
+    }
+
     /// Gets a [file handle](File) to the `loginusers.vdf` file.
     #[inline]
     pub fn vdf_loginusers(&self) -> Result<File> {
@@ -251,4 +723,73 @@ impl Steam {
         )?;
         Ok(unsafe { File::from_raw_handle(handle) })
     }
+
+    /// Replaces a file in the Steam directory with the given contents, atomically.
+    ///
+    /// `subpath` is relative to the Steam directory, e.g. `config\\loginusers.vdf`.
+    pub fn replace_file(&self, subpath: impl AsRef<OsStr>, contents: &[u8]) -> Result<()> {
+        let subpath: Vec<u16> = subpath
+            .as_ref()
+            .encode_wide()
+            .chain(std::iter::once(0))
+            .collect();
+        err_opt(
+            unsafe {
+                steam_file_replace(self, subpath.as_ptr(), contents.as_ptr(), contents.len())
+            }
+            .into(),
+            (),
+        )
+    }
+
+    /// Makes the user the most recent one in `loginusers.vdf` and allows it to auto-login, so that Steam selects it
+    /// even where it doesn't consult the registry.
+    ///
+    /// Only the changed values are written. Returns whether the user is in `loginusers.vdf`.
+    ///
+    /// Note: Steam rewrites `loginusers.vdf` when it exits, so this should be called while it's not running.
+    pub fn select_login_user(&self, username: Username) -> Result<bool> {
+        let mut patched = Vec::new();
+        {
+            let source = self.map_loginusers()?;
+            match crate::stats::time_parse(|| vdf::select_login_user(&source, username.as_bytes()))
+                .map_err(Error::LoginUsersVdf)?
+            {
+                Some(patch) if patch.is_empty() => return Ok(true),
+                Some(patch) => patch.write_to(&mut patched),
+                None => return Ok(false),
+            }
+            // The view is released before the file is replaced, which its mapping would prevent.
+        }
+        self.replace_file("config\\loginusers.vdf", &patched)?;
+        Ok(true)
+    }
+
+    /// Maps a file in the Steam directory into memory (or reads it, if it can't be mapped).
+    ///
+    /// `subpath` is relative to the Steam directory, e.g. `config\\loginusers.vdf`.
+    ///
+    /// Note: keep the view short-lived, Steam can't rewrite the file while it's mapped.
+    pub fn map_file(&self, subpath: impl AsRef<OsStr>) -> Result<FileView> {
+        let subpath: Vec<u16> = subpath
+            .as_ref()
+            .encode_wide()
+            .chain(std::iter::once(0))
+            .collect();
+        let mut view = FileView {
+            data: std::ptr::null(),
+            len: 0,
+            mapped: 0,
+        };
+        err_opt(
+            unsafe { steam_file_map(self, subpath.as_ptr(), &mut view) }.into(),
+            view,
+        )
+    }
+
+    /// Maps the `loginusers.vdf` file into memory, see [`Self::map_file`].
+    #[inline]
+    pub fn map_loginusers(&self) -> Result<FileView> {
+        self.map_file("config\\loginusers.vdf")
+    }
 }
@@ -0,0 +1,107 @@
+//! Push-based tracking of Steam's processes, for long-lived processes such as `diverter serve`.
+
+use std::{ffi::c_void, fmt::Debug, ptr::NonNull, time::Duration};
+
+use winapi::shared::minwindef::DWORD;
+
+use crate::{
+    steam::{err_opt, timeout_ms, CResult, Result},
+    Steam,
+};
+
+/// Reflects `windows.c`'s `steam_tracker_t`, which is opaque.
+type CTracker = c_void;
+
+/// An always-current set of the running Steam processes.
+///
+/// It's seeded by a scan of the system's processes, and is then kept current by waits on the processes' exit, and by
+/// watching Steam's registry key for the active process Steam registers as it starts.
+/// So checking whether Steam is running is a memory read, and waiting for Steam to exit doesn't rescan, except for
+/// one scan once all the tracked processes exit, which confirms that none were missed.
+///
+/// Setting up the tracker costs about as much as a scan, so it only pays off when it's reused.
+pub struct Tracker(NonNull<CTracker>);
+
+// SAFETY: the tracker is synchronized internally, and is only freed on drop.
+unsafe impl Send for Tracker {}
+unsafe impl Sync for Tracker {}
+
+impl Tracker {
+    /// Starts tracking the Steam's processes.
+    ///
+    /// The tracker is independent of the [`Steam`] handle, which may be dropped before it.
+    pub fn new(steam: &Steam) -> Result<Self> {
+        let mut tracker = std::ptr::null_mut();
+        err_opt(
+            unsafe { steam_tracker_start(steam, &mut tracker) }.into(),
+            (),
+        )?;
+        Ok(Self(
+            NonNull::new(tracker).expect("steam_tracker_start succeeded without a tracker"),
+        ))
+    }
+
+    /// Checks if the Steam client is running, see [`Steam::is_running`].
+    #[inline]
+    pub fn is_running(&self) -> Result<bool> {
+        let mut is_running = 0;
+        err_opt(
+            unsafe { steam_tracker_is_running(self.0.as_ptr(), &mut is_running) }.into(),
+            is_running != 0,
+        )
+    }
+
+    /// Waits until all Steam processes exit, see [`Steam::wait_exit`].
+    ///
+    /// Returns whether Steam has exited before the timeout ([`None`] waits indefinitely).
+    #[inline]
+    pub fn wait_exit(&self, timeout: Option<Duration>) -> Result<bool> {
+        let mut exited = 0u8;
+        err_opt(
+            unsafe { steam_tracker_wait_exit(self.0.as_ptr(), timeout_ms(timeout), &mut exited) }
+                .into(),
+            exited != 0,
+        )
+    }
+
+    /// The IDs of the tracked processes.
+    pub fn pids(&self) -> Vec<u32> {
+        let mut pids = Vec::new();
+        loop {
+            let len =
+                unsafe { steam_tracker_pids(self.0.as_ptr(), pids.as_mut_ptr(), pids.capacity()) };
+            if len <= pids.capacity() {
+                unsafe { pids.set_len(len) };
+                return pids;
+            }
+            pids.reserve(len);
+        }
+    }
+}
+
+impl Drop for Tracker {
+    #[inline]
+    fn drop(&mut self) {
+        unsafe { steam_tracker_free(self.0.as_ptr()) }
+    }
+}
+
+impl Debug for Tracker {
+    #[inline]
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_tuple("Tracker").field(&self.pids()).finish()
+    }
+}
+
+#[link(name = "windowsutil")]
+extern "C" {
+    fn steam_tracker_start(steam: *const Steam, tracker: *mut *mut CTracker) -> CResult;
+    fn steam_tracker_free(tracker: *mut CTracker);
+    fn steam_tracker_is_running(tracker: *mut CTracker, is_running: *mut u8) -> CResult;
+    fn steam_tracker_wait_exit(
+        tracker: *mut CTracker,
+        timeout_ms: DWORD,
+        exited: *mut u8,
+    ) -> CResult;
+    fn steam_tracker_pids(tracker: *mut CTracker, pids: *mut DWORD, capacity: usize) -> usize;
+}
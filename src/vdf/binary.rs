@@ -0,0 +1,809 @@
+//! Binary [KeyValues](https://developer.valvesoftware.com/wiki/KeyValues), which Steam uses for files such as
+//! shortcuts.vdf, appinfo.vdf and packageinfo.vdf.
+//!
+//! Binary key-values are read into the same [`Document`] model as text ones, borrowing their keys and strings from
+//! the source.
+
+use super::{
+    parser::{push, Document, Id, Value},
+    Str,
+};
+
+/// Subkeys type.
+const TYPE_SUBKEYS: u8 = 0x00;
+/// String type.
+const TYPE_STRING: u8 = 0x01;
+/// 32-bit integer type.
+const TYPE_INT32: u8 = 0x02;
+/// 32-bit floating point type.
+const TYPE_FLOAT32: u8 = 0x03;
+/// Pointer type.
+const TYPE_POINTER: u8 = 0x04;
+/// UTF-16 string type.
+const TYPE_WIDE_STRING: u8 = 0x05;
+/// Color type.
+const TYPE_COLOR: u8 = 0x06;
+/// Unsigned 64-bit integer type.
+const TYPE_UINT64: u8 = 0x07;
+/// End of block marker.
+const TYPE_END: u8 = 0x08;
+/// 64-bit integer type.
+const TYPE_INT64: u8 = 0x0A;
+/// Alternative end of block marker.
+const TYPE_END_ALT: u8 = 0x0B;
+
+/// The estimated number of source bytes per key-value, for sizing a [`Document`] upfront.
+const SOURCE_BYTES_PER_KEY_VALUE: usize = 16;
+
+/// Binary VDF error.
+#[derive(Debug, Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord, thiserror::Error)]
+pub enum Error {
+    /// The source ended in the middle of an element.
+    #[error("unexpected EOF")]
+    UnexpectedEof,
+    /// A string without a terminating NUL.
+    #[error("expected a string terminator but reached EOF")]
+    UnterminatedString,
+    /// Unknown value type.
+    #[error("unknown value type {0:#04x}")]
+    UnknownType(u8),
+    /// A key index that isn't in the file's key table.
+    #[error("key index {0} is out of range of the key table")]
+    UnknownKey(u32),
+    /// The file doesn't start with a magic number of a supported format.
+    #[error("unsupported file magic {0:#010x}")]
+    UnknownMagic(u32),
+}
+
+/// A position in the source.
+#[derive(Debug, Clone, Copy)]
+struct Cursor<'a> {
+    source: &'a [u8],
+    position: usize,
+}
+
+impl<'a> Cursor<'a> {
+    const fn new(source: &'a [u8]) -> Self {
+        Self {
+            source,
+            position: 0,
+        }
+    }
+
+    const fn is_finished(self) -> bool {
+        self.position >= self.source.len()
+    }
+
+    fn rest(self) -> &'a [u8] {
+        &self.source[self.position..]
+    }
+
+    fn take(&mut self, len: usize) -> Result<&'a [u8], Error> {
+        let bytes = self.rest().get(..len).ok_or(Error::UnexpectedEof)?;
+        self.position += len;
+        Ok(bytes)
+    }
+
+    fn array<const N: usize>(&mut self) -> Result<[u8; N], Error> {
+        let mut bytes = [0; N];
+        bytes.copy_from_slice(self.take(N)?);
+        Ok(bytes)
+    }
+
+    fn u8(&mut self) -> Result<u8, Error> {
+        self.array().map(|[byte]| byte)
+    }
+
+    fn u32(&mut self) -> Result<u32, Error> {
+        self.array().map(u32::from_le_bytes)
+    }
+
+    fn u64(&mut self) -> Result<u64, Error> {
+        self.array().map(u64::from_le_bytes)
+    }
+
+    /// Reads a NUL-terminated string, without the terminator.
+    fn string(&mut self) -> Result<&'a [u8], Error> {
+        let rest = self.rest();
+        let len = rest
+            .iter()
+            .position(|&c| c == 0)
+            .ok_or(Error::UnterminatedString)?;
+        self.position += len + 1;
+        Ok(&rest[..len])
+    }
+
+    /// Reads a NUL-terminated UTF-16LE string, without the terminator.
+    fn wide_string(&mut self) -> Result<&'a [u8], Error> {
+        let rest = self.rest();
+        let len = rest
+            .chunks_exact(2)
+            .position(|unit| unit == [0, 0])
+            .ok_or(Error::UnterminatedString)?
+            * 2;
+        self.position += len + 2;
+        Ok(&rest[..len])
+    }
+
+    /// Reads a key, either inline or by its index in the key table.
+    fn key(&mut self, keys: Option<&[&'a [u8]]>) -> Result<&'a [u8], Error> {
+        match keys {
+            Some(keys) => {
+                let index = self.u32()?;
+                keys.get(index as usize)
+                    .copied()
+                    .ok_or(Error::UnknownKey(index))
+            }
+            None => self.string(),
+        }
+    }
+
+    /// Skips the key-values up to and including the end of the current block, without reading them.
+    fn skip_block(&mut self, keyed: bool) -> Result<(), Error> {
+        let mut depth = 0usize;
+        loop {
+            let r#type = self.u8()?;
+            if matches!(r#type, TYPE_END | TYPE_END_ALT) {
+                match depth.checked_sub(1) {
+                    Some(outer) => depth = outer,
+                    None => break Ok(()),
+                }
+                continue;
+            }
+            if keyed {
+                self.take(4)?;
+            } else {
+                self.string()?;
+            }
+            match r#type {
+                TYPE_SUBKEYS => depth += 1,
+                TYPE_STRING => {
+                    self.string()?;
+                }
+                TYPE_WIDE_STRING => {
+                    self.wide_string()?;
+                }
+                TYPE_INT32 | TYPE_FLOAT32 | TYPE_POINTER | TYPE_COLOR => {
+                    self.take(4)?;
+                }
+                TYPE_UINT64 | TYPE_INT64 => {
+                    self.take(8)?;
+                }
+                _ => break Err(Error::UnknownType(r#type)),
+            }
+        }
+    }
+}
+
+/// Reads key-values into the document, until the end of the top-level block.
+fn parse_into<'a>(
+    cursor: &mut Cursor<'a>,
+    keys: Option<&[&'a [u8]]>,
+    document: &mut Document<'a>,
+) -> Result<(), Error> {
+    // The current block and the last key-value parsed in it, see the text parser.
+    let mut parent = Id::ROOT;
+    let mut previous = None;
+    loop {
+        // Some files omit the top-level end marker.
+        if parent == Id::ROOT && cursor.is_finished() {
+            break Ok(());
+        }
+        let r#type = cursor.u8()?;
+        if matches!(r#type, TYPE_END | TYPE_END_ALT) {
+            if parent == Id::ROOT {
+                break Ok(());
+            }
+            previous = Some(parent);
+            parent = document.0[parent.0].parent;
+            continue;
+        }
+        let key = cursor.key(keys)?;
+        let value = match r#type {
+            TYPE_SUBKEYS => {
+                parent = push(document, &mut previous, parent, key, Value::Subkeys);
+                previous = None;
+                continue;
+            }
+            TYPE_STRING => Value::String(Str::verbatim(cursor.string()?)),
+            TYPE_INT32 => Value::Int32(cursor.u32()? as i32),
+            TYPE_FLOAT32 => Value::Float32(cursor.u32()?),
+            TYPE_POINTER => Value::Pointer(cursor.u32()?),
+            TYPE_WIDE_STRING => Value::WideString(cursor.wide_string()?),
+            TYPE_COLOR => Value::Color(cursor.u32()?),
+            TYPE_UINT64 => Value::UInt64(cursor.u64()?),
+            TYPE_INT64 => Value::Int64(cursor.u64()? as i64),
+            _ => break Err(Error::UnknownType(r#type)),
+        };
+        push(document, &mut previous, parent, key, |_| value);
+    }
+}
+
+/// Parses key-values into a new document.
+fn parse_keyed<'a>(source: &'a [u8], keys: Option<&[&'a [u8]]>) -> Result<Document<'a>, Error> {
+    let mut document = Document(Vec::with_capacity(
+        source.len() / SOURCE_BYTES_PER_KEY_VALUE,
+    ));
+    parse_into(&mut Cursor::new(source), keys, &mut document)?;
+    Ok(document)
+}
+
+/// Parses a binary VDF [`Document`], such as shortcuts.vdf.
+pub fn parse(source: &[u8]) -> Result<Document<'_>, Error> {
+    parse_keyed(source, None)
+}
+
+/// appinfo.vdf magic, up to format version 27.
+const APPINFO_MAGIC_27: u32 = 0x0756_4427;
+/// appinfo.vdf magic, format version 28, which adds an SHA-1 of the binary key-values.
+const APPINFO_MAGIC_28: u32 = 0x0756_4428;
+/// appinfo.vdf magic, format version 29, which moves keys to a table at the end of the file.
+const APPINFO_MAGIC_29: u32 = 0x0756_4429;
+
+/// An appinfo.vdf file, which holds Steam's metadata of apps.
+///
+/// Entries are found through their size fields, so [iterating](AppInfo::entries) them doesn't read their key-values.
+#[derive(Debug, Clone)]
+pub struct AppInfo<'a> {
+    /// The file's format magic.
+    pub magic: u32,
+    /// The Steam universe.
+    pub universe: u32,
+    keys: Option<Vec<&'a [u8]>>,
+    entries: &'a [u8],
+}
+
+impl<'a> AppInfo<'a> {
+    /// Reads an appinfo.vdf header, and its key table when it has one.
+    pub fn new(source: &'a [u8]) -> Result<Self, Error> {
+        let mut cursor = Cursor::new(source);
+        let magic = cursor.u32()?;
+        let universe = cursor.u32()?;
+        let (entries_end, keys) = match magic {
+            APPINFO_MAGIC_27 | APPINFO_MAGIC_28 => (source.len(), None),
+            APPINFO_MAGIC_29 => {
+                let offset = usize::try_from(cursor.u64()?)
+                    .ok()
+                    .filter(|&offset| offset >= cursor.position && offset <= source.len())
+                    .ok_or(Error::UnexpectedEof)?;
+                let mut table = Cursor {
+                    source,
+                    position: offset,
+                };
+                let count = table.u32()? as usize;
+                // Every key takes at least its terminator, which bounds the reservation for bogus counts.
+                let mut keys = Vec::with_capacity(count.min(table.rest().len()));
+                for _ in 0..count {
+                    keys.push(table.string()?);
+                }
+                (offset, Some(keys))
+            }
+            _ => return Err(Error::UnknownMagic(magic)),
+        };
+        Ok(Self {
+            magic,
+            universe,
+            keys,
+            entries: &source[cursor.position..entries_end],
+        })
+    }
+
+    /// Iterates the app entries.
+    pub fn entries(&self) -> AppInfoEntries<'_, 'a> {
+        AppInfoEntries {
+            info: self,
+            cursor: Cursor::new(self.entries),
+        }
+    }
+
+    /// Finds the entry of an app.
+    pub fn get(&self, app_id: u32) -> Result<Option<AppInfoEntry<'_, 'a>>, Error> {
+        for entry in self.entries() {
+            let entry = entry?;
+            if entry.app_id == app_id {
+                return Ok(Some(entry));
+            }
+        }
+        Ok(None)
+    }
+}
+
+/// An app entry in an [`AppInfo`].
+#[derive(Debug, Clone, Copy)]
+pub struct AppInfoEntry<'i, 'a> {
+    /// The app ID.
+    pub app_id: u32,
+    /// The info state.
+    pub info_state: u32,
+    /// When the entry was last updated, as a Unix timestamp.
+    pub last_updated: u32,
+    /// The PICS access token.
+    pub pics_token: u64,
+    /// The SHA-1 of the entry's text key-values.
+    pub sha1: [u8; 20],
+    /// The change number.
+    pub change_number: u32,
+    /// The entry's binary key-values.
+    pub data: &'a [u8],
+    keys: Option<&'i [&'a [u8]]>,
+}
+
+impl<'i, 'a> AppInfoEntry<'i, 'a> {
+    /// Parses the entry's key-values.
+    pub fn document(&self) -> Result<Document<'a>, Error> {
+        parse_keyed(self.data, self.keys)
+    }
+}
+
+/// An iterator over the entries of an [`AppInfo`], see [`AppInfo::entries`].
+#[derive(Debug, Clone)]
+pub struct AppInfoEntries<'i, 'a> {
+    info: &'i AppInfo<'a>,
+    cursor: Cursor<'a>,
+}
+
+impl<'i, 'a> AppInfoEntries<'i, 'a> {
+    fn entry(&mut self) -> Result<Option<AppInfoEntry<'i, 'a>>, Error> {
+        let app_id = self.cursor.u32()?;
+        if app_id == 0 {
+            return Ok(None);
+        }
+        let size = self.cursor.u32()? as usize;
+        let mut entry = Cursor::new(self.cursor.take(size)?);
+        let info_state = entry.u32()?;
+        let last_updated = entry.u32()?;
+        let pics_token = entry.u64()?;
+        let sha1 = entry.array()?;
+        let change_number = entry.u32()?;
+        if self.info.magic != APPINFO_MAGIC_27 {
+            entry.take(20)?;
+        }
+        Ok(Some(AppInfoEntry {
+            app_id,
+            info_state,
+            last_updated,
+            pics_token,
+            sha1,
+            change_number,
+            data: entry.rest(),
+            keys: self.info.keys.as_deref(),
+        }))
+    }
+}
+
+impl<'i, 'a> Iterator for AppInfoEntries<'i, 'a> {
+    type Item = Result<AppInfoEntry<'i, 'a>, Error>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.cursor.is_finished() {
+            return None;
+        }
+        let entry = self.entry().transpose();
+        if !matches!(entry, Some(Ok(_))) {
+            self.cursor.position = self.cursor.source.len();
+        }
+        entry
+    }
+}
+
+/// packageinfo.vdf magic, up to format version 27.
+const PACKAGEINFO_MAGIC_27: u32 = 0x0656_5527;
+/// packageinfo.vdf magic, format version 28, which adds the PICS access token.
+const PACKAGEINFO_MAGIC_28: u32 = 0x0656_5528;
+
+/// The package ID that marks the end of packageinfo.vdf.
+const PACKAGEINFO_END: u32 = !0;
+
+/// A packageinfo.vdf file, which holds Steam's metadata of packages (licenses).
+///
+/// Entries have no size field, so [iterating](PackageInfo::entries) them skims their key-values to find where each
+/// ends.
+#[derive(Debug, Clone, Copy)]
+pub struct PackageInfo<'a> {
+    /// The file's format magic.
+    pub magic: u32,
+    /// The Steam universe.
+    pub universe: u32,
+    entries: &'a [u8],
+}
+
+impl<'a> PackageInfo<'a> {
+    /// Reads a packageinfo.vdf header.
+    pub fn new(source: &'a [u8]) -> Result<Self, Error> {
+        let mut cursor = Cursor::new(source);
+        let magic = cursor.u32()?;
+        let universe = cursor.u32()?;
+        match magic {
+            PACKAGEINFO_MAGIC_27 | PACKAGEINFO_MAGIC_28 => Ok(Self {
+                magic,
+                universe,
+                entries: cursor.rest(),
+            }),
+            _ => Err(Error::UnknownMagic(magic)),
+        }
+    }
+
+    /// Iterates the package entries.
+    pub fn entries(&self) -> PackageInfoEntries<'a> {
+        PackageInfoEntries {
+            magic: self.magic,
+            cursor: Cursor::new(self.entries),
+        }
+    }
+}
+
+/// A package entry in a [`PackageInfo`].
+#[derive(Debug, Clone, Copy)]
+pub struct PackageInfoEntry<'a> {
+    /// The package ID.
+    pub package_id: u32,
+    /// The SHA-1 of the entry's text key-values.
+    pub sha1: [u8; 20],
+    /// The change number.
+    pub change_number: u32,
+    /// The PICS access token, or zero in files before format version 28.
+    pub pics_token: u64,
+    /// The entry's binary key-values.
+    pub data: &'a [u8],
+}
+
+impl<'a> PackageInfoEntry<'a> {
+    /// Parses the entry's key-values.
+    pub fn document(&self) -> Result<Document<'a>, Error> {
+        parse(self.data)
+    }
+}
+
+/// An iterator over the entries of a [`PackageInfo`], see [`PackageInfo::entries`].
+#[derive(Debug, Clone)]
+pub struct PackageInfoEntries<'a> {
+    magic: u32,
+    cursor: Cursor<'a>,
+}
+
+impl<'a> PackageInfoEntries<'a> {
+    fn entry(&mut self) -> Result<Option<PackageInfoEntry<'a>>, Error> {
+        let package_id = self.cursor.u32()?;
+        if package_id == PACKAGEINFO_END {
+            return Ok(None);
+        }
+        let sha1 = self.cursor.array()?;
+        let change_number = self.cursor.u32()?;
+        let pics_token = if self.magic == PACKAGEINFO_MAGIC_27 {
+            0
+        } else {
+            self.cursor.u64()?
+        };
+        let start = self.cursor.position;
+        self.cursor.skip_block(false)?;
+        Ok(Some(PackageInfoEntry {
+            package_id,
+            sha1,
+            change_number,
+            pics_token,
+            data: &self.cursor.source[start..self.cursor.position],
+        }))
+    }
+}
+
+impl<'a> Iterator for PackageInfoEntries<'a> {
+    type Item = Result<PackageInfoEntry<'a>, Error>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.cursor.is_finished() {
+            return None;
+        }
+        let entry = self.entry().transpose();
+        if !matches!(entry, Some(Ok(_))) {
+            self.cursor.position = self.cursor.source.len();
+        }
+        entry
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// An entry's key-values: `{ "appinfo" { "appid" 10, "name" "Game", "common" { "type" "game" } } }`, with
+    /// inline keys, or with indices into [`KEYS`] if `keyed`.
+    fn key_values(keyed: bool) -> Vec<u8> {
+        let mut out = Vec::new();
+        let key = |out: &mut Vec<u8>, r#type: u8, key: &str| {
+            out.push(r#type);
+            if keyed {
+                let index = KEYS.iter().position(|&k| k == key).unwrap() as u32;
+                out.extend(index.to_le_bytes());
+            } else {
+                out.extend(key.as_bytes());
+                out.push(0);
+            }
+        };
+        key(&mut out, TYPE_SUBKEYS, "appinfo");
+        key(&mut out, TYPE_INT32, "appid");
+        out.extend(10u32.to_le_bytes());
+        key(&mut out, TYPE_STRING, "name");
+        out.extend(b"Game\0");
+        key(&mut out, TYPE_SUBKEYS, "common");
+        key(&mut out, TYPE_STRING, "type");
+        out.extend(b"game\0");
+        out.extend([TYPE_END, TYPE_END, TYPE_END]);
+        out
+    }
+
+    /// The key table of the version 29 fixture.
+    const KEYS: [&str; 5] = ["appinfo", "appid", "name", "common", "type"];
+
+    /// Builds an appinfo.vdf with entries for apps 10 and 20, returning it with the offsets where its entries end.
+    fn appinfo(magic: u32) -> (Vec<u8>, Vec<usize>) {
+        let keyed = magic == APPINFO_MAGIC_29;
+        let data = key_values(keyed);
+        let mut file = Vec::new();
+        file.extend(magic.to_le_bytes());
+        file.extend(1u32.to_le_bytes());
+        if keyed {
+            // The key table offset, filled in below.
+            file.extend(0u64.to_le_bytes());
+        }
+        let mut boundaries = vec![file.len()];
+        for app_id in [10u32, 20] {
+            let mut entry = Vec::new();
+            entry.extend(2u32.to_le_bytes());
+            entry.extend(1_690_000_000u32.to_le_bytes());
+            entry.extend(0xDEAD_BEEFu64.to_le_bytes());
+            entry.extend([0xAA; 20]);
+            entry.extend(app_id.to_le_bytes());
+            if magic != APPINFO_MAGIC_27 {
+                entry.extend([0xBB; 20]);
+            }
+            entry.extend(&data);
+            file.extend(app_id.to_le_bytes());
+            file.extend((entry.len() as u32).to_le_bytes());
+            file.extend(entry);
+            boundaries.push(file.len());
+        }
+        file.extend(0u32.to_le_bytes());
+        boundaries.push(file.len());
+        if keyed {
+            let offset = file.len() as u64;
+            file[8..16].copy_from_slice(&offset.to_le_bytes());
+            file.extend((KEYS.len() as u32).to_le_bytes());
+            for key in KEYS {
+                file.extend(key.as_bytes());
+                file.push(0);
+            }
+        }
+        (file, boundaries)
+    }
+
+    /// Builds a packageinfo.vdf with entries for packages 1 and 2, returning it with the offsets where its entries
+    /// end.
+    fn packageinfo(magic: u32) -> (Vec<u8>, Vec<usize>) {
+        let mut file = Vec::new();
+        file.extend(magic.to_le_bytes());
+        file.extend(1u32.to_le_bytes());
+        let mut boundaries = vec![file.len()];
+        for package_id in [1u32, 2] {
+            file.extend(package_id.to_le_bytes());
+            file.extend([0xCC; 20]);
+            file.extend(7u32.to_le_bytes());
+            if magic != PACKAGEINFO_MAGIC_27 {
+                file.extend(0xFEEDu64.to_le_bytes());
+            }
+            file.push(TYPE_SUBKEYS);
+            file.extend(format!("{package_id}\0").as_bytes());
+            file.push(TYPE_INT32);
+            file.extend(b"packageid\0");
+            file.extend(package_id.to_le_bytes());
+            file.push(TYPE_SUBKEYS);
+            file.extend(b"appids\0");
+            file.push(TYPE_INT32);
+            file.extend(b"0\0");
+            file.extend(10u32.to_le_bytes());
+            file.extend([TYPE_END, TYPE_END, TYPE_END]);
+            boundaries.push(file.len());
+        }
+        file.extend(PACKAGEINFO_END.to_le_bytes());
+        boundaries.push(file.len());
+        (file, boundaries)
+    }
+
+    /// Reads every entry of an appinfo.vdf and its key-values.
+    fn read_appinfo(source: &[u8]) -> Result<Vec<(u32, Document<'_>)>, Error> {
+        let info = AppInfo::new(source)?;
+        let mut apps = Vec::new();
+        for entry in info.entries() {
+            let entry = entry?;
+            apps.push((entry.app_id, entry.document()?));
+        }
+        Ok(apps)
+    }
+
+    /// Reads every entry of a packageinfo.vdf and its key-values.
+    fn read_packageinfo(source: &[u8]) -> Result<Vec<(u32, Document<'_>)>, Error> {
+        let info = PackageInfo::new(source)?;
+        let mut packages = Vec::new();
+        for entry in info.entries() {
+            let entry = entry?;
+            packages.push((entry.package_id, entry.document()?));
+        }
+        Ok(packages)
+    }
+
+    /// Reads a top-level block's key-values by key, with their values.
+    fn block<'a>(document: &Document<'a>, path: &[&[u8]]) -> Vec<(&'a [u8], Value<'a>)> {
+        let mut at = Id::ROOT;
+        for key in path {
+            at = document.subkeys(at, key).expect("the block exists");
+        }
+        document
+            .children(at)
+            .map(|row| (row.key, row.value))
+            .collect()
+    }
+
+    fn check_app(document: &Document) {
+        let app = block(document, &[b"appinfo"]);
+        assert_eq!(app[0], (&b"appid"[..], Value::Int32(10)));
+        assert_eq!(
+            app[1],
+            (&b"name"[..], Value::String(Str::verbatim(b"Game")))
+        );
+        assert_eq!(
+            block(document, &[b"appinfo", b"common"]),
+            [(&b"type"[..], Value::String(Str::verbatim(b"game")))]
+        );
+    }
+
+    #[test]
+    fn reads_appinfo() {
+        for magic in [APPINFO_MAGIC_27, APPINFO_MAGIC_28, APPINFO_MAGIC_29] {
+            let (file, _) = appinfo(magic);
+            let info = AppInfo::new(&file).unwrap();
+            assert_eq!((info.magic, info.universe), (magic, 1));
+
+            let entry = info.get(20).unwrap().unwrap();
+            assert_eq!(entry.info_state, 2);
+            assert_eq!(entry.last_updated, 1_690_000_000);
+            assert_eq!(entry.pics_token, 0xDEAD_BEEF);
+            assert_eq!(entry.sha1, [0xAA; 20]);
+            assert_eq!(entry.change_number, 20);
+            assert!(info.get(30).unwrap().is_none());
+
+            let apps = read_appinfo(&file).unwrap();
+            assert_eq!(apps.iter().map(|(id, _)| *id).collect::<Vec<_>>(), [10, 20]);
+            for (_, document) in &apps {
+                check_app(document);
+            }
+        }
+    }
+
+    #[test]
+    fn reads_packageinfo() {
+        for magic in [PACKAGEINFO_MAGIC_27, PACKAGEINFO_MAGIC_28] {
+            let (file, _) = packageinfo(magic);
+            let info = PackageInfo::new(&file).unwrap();
+            assert_eq!((info.magic, info.universe), (magic, 1));
+
+            let entries: Vec<_> = info.entries().collect::<Result<_, _>>().unwrap();
+            assert_eq!(entries.len(), 2);
+            assert_eq!(entries[1].package_id, 2);
+            assert_eq!(entries[1].sha1, [0xCC; 20]);
+            assert_eq!(entries[1].change_number, 7);
+            let pics_token = if magic == PACKAGEINFO_MAGIC_27 {
+                0
+            } else {
+                0xFEED
+            };
+            assert_eq!(entries[1].pics_token, pics_token);
+
+            let document = entries[1].document().unwrap();
+            assert_eq!(
+                block(&document, &[b"2"]),
+                [
+                    (&b"packageid"[..], Value::Int32(2)),
+                    (&b"appids"[..], Value::Subkeys(Id(2))),
+                ]
+            );
+            assert_eq!(
+                block(&document, &[b"2", b"appids"]),
+                [(&b"0"[..], Value::Int32(10))]
+            );
+        }
+    }
+
+    #[test]
+    fn truncated_appinfo_is_an_error() {
+        for magic in [APPINFO_MAGIC_27, APPINFO_MAGIC_28, APPINFO_MAGIC_29] {
+            let (file, boundaries) = appinfo(magic);
+            for len in 0..file.len() {
+                let result = read_appinfo(&file[..len]);
+                // Without a key table, a file cut between entries reads as a file with fewer entries.
+                if magic != APPINFO_MAGIC_29 && boundaries.contains(&len) {
+                    let apps = result.unwrap();
+                    let expected = boundaries.iter().position(|&b| b == len).unwrap().min(2);
+                    assert_eq!(apps.len(), expected, "{magic:#x} cut at {len}");
+                } else {
+                    assert!(result.is_err(), "{magic:#x} cut at {len}");
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn truncated_packageinfo_is_an_error() {
+        for magic in [PACKAGEINFO_MAGIC_27, PACKAGEINFO_MAGIC_28] {
+            let (file, boundaries) = packageinfo(magic);
+            for len in 0..file.len() {
+                let result = read_packageinfo(&file[..len]);
+                if boundaries.contains(&len) {
+                    let packages = result.unwrap();
+                    let expected = boundaries.iter().position(|&b| b == len).unwrap().min(2);
+                    assert_eq!(packages.len(), expected, "{magic:#x} cut at {len}");
+                } else {
+                    assert!(result.is_err(), "{magic:#x} cut at {len}");
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn truncated_key_values_are_an_error() {
+        let data = key_values(false);
+        assert!(parse(&[]).unwrap().0.is_empty());
+        // The top-level end marker may be omitted, but nothing before it.
+        assert!(parse(&data[..data.len() - 1]).is_ok());
+        for len in 1..data.len() - 1 {
+            assert!(parse(&data[..len]).is_err(), "cut at {len}");
+        }
+    }
+
+    #[test]
+    fn bad_magic_is_an_error() {
+        let (mut file, _) = appinfo(APPINFO_MAGIC_28);
+        for magic in [0, 0x0756_4426, 0x0756_442A, PACKAGEINFO_MAGIC_28] {
+            file[..4].copy_from_slice(&u32::to_le_bytes(magic));
+            assert_eq!(AppInfo::new(&file).err(), Some(Error::UnknownMagic(magic)));
+        }
+        let (mut file, _) = packageinfo(PACKAGEINFO_MAGIC_28);
+        for magic in [0, 0x0656_5526, 0x0656_5529, APPINFO_MAGIC_28] {
+            file[..4].copy_from_slice(&u32::to_le_bytes(magic));
+            assert_eq!(
+                PackageInfo::new(&file).err(),
+                Some(Error::UnknownMagic(magic))
+            );
+        }
+    }
+
+    #[test]
+    fn bad_key_table_is_an_error() {
+        let (file, _) = appinfo(APPINFO_MAGIC_29);
+        let table = u64::from_le_bytes(file[8..16].try_into().unwrap()) as usize;
+
+        // An offset past the end of the file, or into the header.
+        for offset in [file.len() as u64 + 1, u64::MAX, 4] {
+            let mut file = file.clone();
+            file[8..16].copy_from_slice(&offset.to_le_bytes());
+            assert_eq!(AppInfo::new(&file).err(), Some(Error::UnexpectedEof));
+        }
+
+        // More keys than the table holds.
+        let mut bogus = file.clone();
+        bogus[table..table + 4].copy_from_slice(&u32::MAX.to_le_bytes());
+        assert_eq!(AppInfo::new(&bogus).err(), Some(Error::UnterminatedString));
+
+        // Fewer keys than the entries use.
+        let mut short = file.clone();
+        short[table..table + 4].copy_from_slice(&2u32.to_le_bytes());
+        assert_eq!(read_appinfo(&short).err(), Some(Error::UnknownKey(2)));
+    }
+
+    #[test]
+    fn unknown_type_is_an_error() {
+        assert_eq!(parse(b"\x09key\0").err(), Some(Error::UnknownType(0x09)));
+        assert_eq!(
+            parse(b"\x00a\0\x01b\0c\0\x0Cd\0").err(),
+            Some(Error::UnknownType(0x0C))
+        );
+    }
+}
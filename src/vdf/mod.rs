@@ -8,35 +8,61 @@ use std::fmt::Debug;
 pub use scanner::{Error as ScanError, Scanner, Token, TokenType};
 
 mod parser;
-pub use parser::{parse, Error as ParseError, Id as ExprId, Value};
+pub use parser::{
+    parse, parse_into, parse_with_capacity, Document, Error as ParseError, Id as ExprId, Value,
+};
 
-use crate::util::OkIter;
+mod reader;
+pub use reader::{Event, Reader};
+
+mod patch;
+pub use patch::Patch;
+
+mod string;
+pub use string::Str;
+
+pub mod binary;
 
-use self::parser::Document;
+use crate::util::OkIter;
 
 /// A login user record.
 #[derive(Clone, Copy)]
 pub struct LoginUser<'a> {
+    /// The user's SteamID64, in decimal.
+    pub steam_id: &'a [u8],
     /// The user's username.
     pub username: &'a [u8],
     /// The user's nickname.
-    pub nickname: &'a [u8],
+    pub nickname: Str<'a>,
     /// Whether the user can be auto logged in.
     pub allow_auto_login: bool,
+    /// Whether the user is the one that logged in most recently.
+    pub most_recent: bool,
+    /// When the user last logged in, as a Unix timestamp, or 0 if unknown.
+    pub timestamp: u64,
+    /// Whether Steam remembers the user's password.
+    pub remember_password: bool,
+    /// Whether the user logs in in offline mode.
+    pub wants_offline_mode: bool,
 }
 
 impl<'a> Debug for LoginUser<'a> {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         f.debug_struct("LoginUser")
             .field(
-                "username",
-                &format_args!("\"{}\"", self.username.escape_ascii()),
+                "steam_id",
+                &format_args!("\"{}\"", self.steam_id.escape_ascii()),
             )
             .field(
-                "nickname",
-                &format_args!("\"{}\"", self.nickname.escape_ascii()),
+                "username",
+                &format_args!("\"{}\"", self.username.escape_ascii()),
             )
+            .field("nickname", &self.nickname)
             .field("allow_auto_login", &self.allow_auto_login)
+            .field("most_recent", &self.most_recent)
+            .field("timestamp", &self.timestamp)
+            .field("remember_password", &self.remember_password)
+            .field("wants_offline_mode", &self.wants_offline_mode)
             .finish()
     }
 }
@@ -56,38 +82,219 @@ pub enum LoginUserVdfError {
     /// "users" key isn't associated with subkeys.
     #[error("expected \"users\" key (which was found) to have subkeys associated with it in loginusers.vdf")]
     ExpectedUserEntryToBeSubkeys,
+    /// Malformed VDF.
+    #[error("malformed loginusers.vdf: {0}")]
+    Syntax(#[from] ScanParseError),
 }
 
 impl<'a> LoginUser<'a> {
-    /// Read [`LoginUser`]s from a VDF [`Document`].
-    pub fn from_vdf(
-        document: &'a Document,
-    ) -> Result<
-        impl Iterator<Item = Result<LoginUser<'a>, LoginUserVdfError>> + 'a,
-        LoginUserVdfError,
-    > {
-        let users_sub = document
-            .subkeys(ExprId::ROOT, b"users")
-            .ok_or(LoginUserVdfError::ExpectedUsersSubkeys)?;
-        let user_ids = document.0.iter().filter(move |row| row.parent == users_sub);
-        Ok(user_ids.map(|user_sub| {
-            if let Value::Subkeys(user_keyvals) = user_sub.value {
-                Ok(Self {
-                    username: document
-                        .value_str(user_keyvals, b"AccountName")
-                        .ok_or(LoginUserVdfError::ExpectedAccountNameKey)?,
-                    nickname: document
-                        .value_str(user_keyvals, b"PersonaName")
-                        .ok_or(LoginUserVdfError::ExpectedPersonaNameKey)?,
-                    allow_auto_login: document
-                        .value_str(user_keyvals, b"AllowAutoLogin")
-                        .map_or(false, |value| value != b"0"),
-                })
-            } else {
-                Err(LoginUserVdfError::ExpectedUserEntryToBeSubkeys)
+    /// Gets the user's account ID, which is the low 32 bits of its [SteamID64](Self::steam_id).
+    pub fn account_id(&self) -> Option<u32> {
+        let steam_id: u64 = std::str::from_utf8(self.steam_id).ok()?.parse().ok()?;
+        Some(steam_id as u32)
+    }
+
+    /// Reads a [`LoginUser`] from its block in a loginusers.vdf [`Document`].
+    pub fn from_block(document: &Document<'a>, user: ExprId) -> Result<Self, LoginUserVdfError> {
+        let block = document
+            .get(user)
+            .ok_or(LoginUserVdfError::ExpectedUserEntryToBeSubkeys)?;
+        if !matches!(block.value, Value::Subkeys(_)) {
+            return Err(LoginUserVdfError::ExpectedUserEntryToBeSubkeys);
+        }
+        let mut fields = LoginUserFields::default();
+        for row in document.children(user) {
+            if let Value::String(value) = row.value {
+                fields.set(row.key, value);
             }
-        }))
+        }
+        fields.into_user(block.key)
     }
+
+    /// Reads [`LoginUser`]s from a loginusers.vdf source.
+    ///
+    /// The users are read as they're iterated, and reading stops at the end of the "users" block.
+    pub fn from_vdf(source: &'a [u8]) -> Result<LoginUsers<'a>, LoginUserVdfError> {
+        let mut reader = Reader::new(source);
+        if reader.find_block(&[b"users"])? {
+            Ok(LoginUsers {
+                reader,
+                done: false,
+            })
+        } else {
+            Err(LoginUserVdfError::ExpectedUsersSubkeys)
+        }
+    }
+}
+
+/// The values of a user block's keys that make up a [`LoginUser`], collected in a single pass over the block.
+#[derive(Debug, Default, Clone, Copy)]
+struct LoginUserFields<'a> {
+    account_name: Option<Str<'a>>,
+    persona_name: Option<Str<'a>>,
+    allow_auto_login: Option<Str<'a>>,
+    most_recent: Option<Str<'a>>,
+    timestamp: Option<Str<'a>>,
+    remember_password: Option<Str<'a>>,
+    wants_offline_mode: Option<Str<'a>>,
+}
+
+impl<'a> LoginUserFields<'a> {
+    /// Collects a key's value if it's one of the fields, keeping the first value of repeated keys.
+    #[inline]
+    fn set(&mut self, key: &[u8], value: Str<'a>) {
+        // Compiles to a dispatch on the key's length, then a comparison against the keys of that length.
+        let field = match key {
+            b"AccountName" => &mut self.account_name,
+            b"PersonaName" => &mut self.persona_name,
+            b"AllowAutoLogin" => &mut self.allow_auto_login,
+            b"MostRecent" => &mut self.most_recent,
+            b"Timestamp" => &mut self.timestamp,
+            b"RememberPassword" => &mut self.remember_password,
+            b"WantsOfflineMode" => &mut self.wants_offline_mode,
+            _ => return,
+        };
+        field.get_or_insert(value);
+    }
+
+    fn into_user(self, steam_id: &'a [u8]) -> Result<LoginUser<'a>, LoginUserVdfError> {
+        let flag = |value: Option<Str>| value.map_or(false, |value| value.raw() != b"0");
+        Ok(LoginUser {
+            steam_id,
+            username: self
+                .account_name
+                .ok_or(LoginUserVdfError::ExpectedAccountNameKey)?
+                .raw(),
+            nickname: self
+                .persona_name
+                .ok_or(LoginUserVdfError::ExpectedPersonaNameKey)?,
+            allow_auto_login: flag(self.allow_auto_login),
+            most_recent: flag(self.most_recent),
+            timestamp: self
+                .timestamp
+                .and_then(|value| std::str::from_utf8(value.raw()).ok()?.parse().ok())
+                .unwrap_or(0),
+            remember_password: flag(self.remember_password),
+            wants_offline_mode: flag(self.wants_offline_mode),
+        })
+    }
+}
+
+/// An iterator over the [`LoginUser`]s in a loginusers.vdf source, see [`LoginUser::from_vdf`].
+#[derive(Debug, Clone)]
+pub struct LoginUsers<'a> {
+    reader: Reader<'a>,
+    done: bool,
+}
+
+impl<'a> LoginUsers<'a> {
+    /// Reads the rest of a user's block.
+    fn user(&mut self, steam_id: &'a [u8]) -> Result<LoginUser<'a>, LoginUserVdfError> {
+        let mut fields = LoginUserFields::default();
+        loop {
+            match self.reader.next().transpose()? {
+                Some(Event::KeyValue(key, value)) => fields.set(key, value),
+                Some(Event::Enter(_)) => self.reader.skip_block()?,
+                Some(Event::Exit) | None => break,
+            }
+        }
+        fields.into_user(steam_id)
+    }
+}
+
+impl<'a> Iterator for LoginUsers<'a> {
+    type Item = Result<LoginUser<'a>, LoginUserVdfError>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.done {
+            return None;
+        }
+        let user = match self.reader.next() {
+            Some(Ok(Event::Enter(steam_id))) => self.user(steam_id),
+            Some(Ok(Event::KeyValue(..))) => Err(LoginUserVdfError::ExpectedUserEntryToBeSubkeys),
+            Some(Ok(Event::Exit)) | None => {
+                self.done = true;
+                return None;
+            }
+            Some(Err(e)) => Err(e.into()),
+        };
+        Some(user)
+    }
+}
+
+/// Sets the value of a user's key, inserting the key at the end of the user's block if it's missing.
+///
+/// `value` is the value's content between the quotes, and `end` is the position of the block's closing brace.
+fn patch_user_value(patch: &mut Patch, value: Option<&[u8]>, end: usize, key: &str, to: &[u8]) {
+    match value {
+        Some(value) if value == to => {}
+        Some(value) => patch.replace(patch.span(value), to),
+        // Indented as Steam does: one level deeper than the user's block, which starts the brace's line.
+        None => patch.insert(
+            end,
+            [b"\t\"", key.as_bytes(), b"\"\t\t\"", to, b"\"\n\t"].concat(),
+        ),
+    }
+}
+
+/// Prepares a loginusers.vdf [`Patch`] that makes the user the [most recent](LoginUser::most_recent) one, and
+/// [allows it to auto-login](LoginUser::allow_auto_login).
+///
+/// Only the values that need to change are edited. Returns [`None`] if the user isn't in the source.
+pub fn select_login_user<'a>(
+    source: &'a [u8],
+    username: &[u8],
+) -> Result<Option<Patch<'a>>, LoginUserVdfError> {
+    let mut patch = Patch::new(source);
+    let mut found = false;
+    let mut reader = Reader::new(source);
+    if !reader.find_block(&[b"users"])? {
+        return Err(LoginUserVdfError::ExpectedUsersSubkeys);
+    }
+    loop {
+        match reader.next().transpose()? {
+            Some(Event::Enter(_)) => {}
+            Some(Event::KeyValue(..)) => continue,
+            Some(Event::Exit) | None => break,
+        }
+        let mut account_name = None;
+        let mut most_recent = None;
+        let mut allow_auto_login = None;
+        loop {
+            match reader.next().transpose()? {
+                Some(Event::KeyValue(key, value)) => {
+                    let field = match key {
+                        b"AccountName" => &mut account_name,
+                        b"MostRecent" => &mut most_recent,
+                        b"AllowAutoLogin" => &mut allow_auto_login,
+                        _ => continue,
+                    };
+                    field.get_or_insert(value.raw());
+                }
+                Some(Event::Enter(_)) => reader.skip_block()?,
+                Some(Event::Exit) | None => break,
+            }
+        }
+        let end = reader.position() - 1;
+        let selected = account_name.map_or(false, |name| name.eq_ignore_ascii_case(username));
+        found |= selected;
+        if selected {
+            // Edits are made in source order, which is the keys' order in the block.
+            let mut edits = [
+                (most_recent, "MostRecent"),
+                (allow_auto_login, "AllowAutoLogin"),
+            ];
+            edits.sort_by_key(|(value, _)| {
+                value.map_or(usize::MAX, |value| patch.span(value).start)
+            });
+            for (value, key) in edits {
+                patch_user_value(&mut patch, value, end, key, b"1");
+            }
+        } else if most_recent.is_some() {
+            patch_user_value(&mut patch, most_recent, end, "MostRecent", b"0");
+        }
+    }
+    Ok(found.then_some(patch))
 }
 
 /// [Scan](ScanError) or [parse](ParseError) error.
@@ -101,12 +308,135 @@ pub enum ScanParseError {
     ParseError(#[from] ParseError),
 }
 
+/// The estimated number of source bytes per key-value, for sizing a [`Document`] upfront.
+///
+/// Key-values in Steam's files are typically an indented line of a short key and value, and the estimate errs
+/// towards reserving more, so that the document grows at most once.
+const SOURCE_BYTES_PER_KEY_VALUE: usize = 20;
+
 /// Scans and parses the source text.
 pub fn scan_parse(source: &[u8]) -> Result<Document, ScanParseError> {
+    let mut document = Document(Vec::new());
+    scan_parse_into(source, &mut document)?;
+    Ok(document)
+}
+
+/// Scans and parses the source text into the given [`Document`], reusing its allocation, see [`parse_into`].
+pub fn scan_parse_into<'a>(
+    source: &'a [u8],
+    document: &mut Document<'a>,
+) -> Result<(), ScanParseError> {
+    document.0.clear();
+    document
+        .0
+        .reserve(source.len() / SOURCE_BYTES_PER_KEY_VALUE);
     let mut tokens = OkIter::new(Scanner::new(source));
-    let result = parse(&mut tokens);
+    let result = parse_into(&mut tokens, document);
     match tokens.to_error() {
         Some(&e) => Err(e.into()),
         None => result.map_err(ScanParseError::ParseError),
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A loginusers.vdf as Steam writes it, where "alice" is the most recent user and "Bob" has no auto-login key.
+    const LOGINUSERS: &str = "\"users\"
+{
+\t\"76561197960265729\"
+\t{
+\t\t\"AccountName\"\t\t\"alice\"
+\t\t\"PersonaName\"\t\t\"Alice\"
+\t\t\"MostRecent\"\t\t\"1\"
+\t\t\"AllowAutoLogin\"\t\t\"1\"
+\t}
+\t\"76561197960265730\"
+\t{
+\t\t\"AccountName\"\t\t\"Bob\"
+\t\t\"PersonaName\"\t\t\"{\\\"bob\\\"}\"
+\t\t\"MostRecent\"\t\t\"0\"
+\t\t\"Extra\"
+\t\t{
+\t\t\t\"AccountName\"\t\t\"alice\"
+\t\t}
+\t}
+\t\"76561197960265731\"
+\t{
+\t\t\"AccountName\"\t\t\"carol\"
+\t}
+}
+";
+
+    fn patched(source: &[u8], username: &[u8]) -> Option<Vec<u8>> {
+        let patch = select_login_user(source, username).unwrap()?;
+        let mut out = Vec::new();
+        patch.write_to(&mut out);
+        assert_eq!(out.len(), patch.len());
+        Some(out)
+    }
+
+    #[test]
+    fn select_login_user_keeps_the_layout() {
+        let bob = patched(LOGINUSERS.as_bytes(), b"bob").unwrap();
+        let expected = LOGINUSERS
+            .replacen("\"MostRecent\"\t\t\"1\"", "\"MostRecent\"\t\t\"0\"", 1)
+            .replacen(
+                "\"MostRecent\"\t\t\"0\"\n\t\t\"Extra\"",
+                "\"MostRecent\"\t\t\"1\"\n\t\t\"Extra\"",
+                1,
+            )
+            .replacen(
+                "\t\t}\n\t}",
+                "\t\t}\n\t\t\"AllowAutoLogin\"\t\t\"1\"\n\t}",
+                1,
+            );
+        assert_eq!(String::from_utf8(bob).unwrap(), expected);
+
+        // Both keys are inserted where neither exists, and the other users are only edited where they have a
+        // MostRecent key.
+        let carol = patched(LOGINUSERS.as_bytes(), b"carol").unwrap();
+        let expected = LOGINUSERS
+            .replacen("\"MostRecent\"\t\t\"1\"", "\"MostRecent\"\t\t\"0\"", 1)
+            .replacen(
+                "\"carol\"\n\t}",
+                "\"carol\"\n\t\t\"MostRecent\"\t\t\"1\"\n\t\t\"AllowAutoLogin\"\t\t\"1\"\n\t}",
+                1,
+            );
+        assert_eq!(String::from_utf8(carol).unwrap(), expected);
+    }
+
+    #[test]
+    fn select_login_user_is_idempotent() {
+        for username in [&b"alice"[..], b"Bob", b"carol"] {
+            let once = patched(LOGINUSERS.as_bytes(), username).unwrap();
+            let patch = select_login_user(&once, username).unwrap().unwrap();
+            assert!(patch.is_empty(), "{}", username.escape_ascii());
+            let mut twice = Vec::new();
+            patch.write_to(&mut twice);
+            assert_eq!(twice, once);
+        }
+        // The most recent user is already selected, so nothing needs to change the first time either.
+        let patch = select_login_user(LOGINUSERS.as_bytes(), b"alice")
+            .unwrap()
+            .unwrap();
+        assert!(patch.is_empty());
+    }
+
+    #[test]
+    fn select_login_user_needs_a_known_user() {
+        assert!(select_login_user(LOGINUSERS.as_bytes(), b"dave")
+            .unwrap()
+            .is_none());
+        // A nested block's AccountName isn't a user's.
+        assert!(select_login_user(LOGINUSERS.as_bytes(), b"Extra")
+            .unwrap()
+            .is_none());
+        assert_eq!(
+            select_login_user(b"\"config\" { }", b"alice").err(),
+            Some(LoginUserVdfError::ExpectedUsersSubkeys)
+        );
+        assert!(select_login_user(b"\"users\" { \"1\" {", b"alice").is_err());
+    }
+}
@@ -1,7 +1,10 @@
-use super::Token;
-use core::fmt::{self, Debug, Formatter};
+use super::{Str, Token};
+use core::{
+    fmt::{self, Debug, Formatter},
+    mem::ManuallyDrop,
+};
 
-/// A [`Document`] element ID.
+/// A [`Document`] element ID, which is the index of its [`KeyValue`] in the document.
 #[derive(Debug, Hash, Default, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
 #[repr(transparent)]
 pub struct Id(pub usize);
@@ -15,9 +18,23 @@ impl Id {
 #[derive(Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
 pub enum Value<'a> {
     /// A string value.
-    String(&'a [u8]),
-    /// Subkeys value.
+    String(Str<'a>),
+    /// Subkeys value, identified by the [`Id`] of the key-value they're associated with.
     Subkeys(Id),
+    /// A 32-bit integer value (binary VDF only).
+    Int32(i32),
+    /// A 32-bit floating point value, by its [bits](f32::from_bits) (binary VDF only).
+    Float32(u32),
+    /// A pointer value (binary VDF only).
+    Pointer(u32),
+    /// A UTF-16LE string value (binary VDF only).
+    WideString(&'a [u8]),
+    /// A color value (binary VDF only).
+    Color(u32),
+    /// An unsigned 64-bit integer value (binary VDF only).
+    UInt64(u64),
+    /// A 64-bit integer value (binary VDF only).
+    Int64(i64),
 }
 
 impl<'a> Debug for Value<'a> {
@@ -25,9 +42,29 @@ impl<'a> Debug for Value<'a> {
         match *self {
             Self::String(str) => f
                 .debug_tuple("String")
-                .field(&format_args!("{}", str.escape_ascii()))
+                .field(&format_args!("{}", str.raw().escape_ascii()))
                 .finish(),
             Self::Subkeys(id) => f.debug_tuple("Subkeys").field(&id).finish(),
+            Self::Int32(value) => f.debug_tuple("Int32").field(&value).finish(),
+            Self::Float32(bits) => f
+                .debug_tuple("Float32")
+                .field(&f32::from_bits(bits))
+                .finish(),
+            Self::Pointer(value) => f.debug_tuple("Pointer").field(&value).finish(),
+            Self::WideString(str) => f
+                .debug_tuple("WideString")
+                .field(&String::from_utf16_lossy(
+                    &str.chunks_exact(2)
+                        .map(|unit| u16::from_le_bytes([unit[0], unit[1]]))
+                        .collect::<Vec<_>>(),
+                ))
+                .finish(),
+            Self::Color(value) => f
+                .debug_tuple("Color")
+                .field(&format_args!("{value:#010x}"))
+                .finish(),
+            Self::UInt64(value) => f.debug_tuple("UInt64").field(&value).finish(),
+            Self::Int64(value) => f.debug_tuple("Int64").field(&value).finish(),
         }
     }
 }
@@ -41,9 +78,17 @@ pub struct KeyValue<'a> {
     pub key: &'a [u8],
     /// The value part.
     pub value: Value<'a>,
+    /// The first key-value in the subkeys, if the value is non-empty [subkeys](Value::Subkeys).
+    pub first_child: Option<Id>,
+    /// The next key-value specified in the same block.
+    pub next_sibling: Option<Id>,
 }
 
 /// A VDF document.
+///
+/// The key-values are stored in the order they're specified, which places each block's key-values after it.
+/// [`KeyValue`]s link to their parent, first child and next sibling by [`Id`], so walking the document requires no
+/// searching.
 #[derive(Hash, Default, Clone, PartialEq, PartialOrd, Eq, Ord)]
 #[repr(transparent)]
 pub struct Document<'a>(pub Vec<KeyValue<'a>>);
@@ -62,9 +107,40 @@ impl<'a> Debug for Document<'a> {
 }
 
 impl<'a> Document<'a> {
+    /// Empties the document for reuse with another source, keeping its allocation, see [`parse_into`].
+    pub fn recycle<'b>(self) -> Document<'b> {
+        let mut key_values = ManuallyDrop::new(self.0);
+        key_values.clear();
+        let (pointer, capacity) = (key_values.as_mut_ptr(), key_values.capacity());
+        // SAFETY: the allocation is taken over from the vector, which won't free it. The vector is empty, so it holds
+        // no borrows of the old source, and key-values of either lifetime have the same layout, so the allocation
+        // fits the same capacity of them.
+        Document(unsafe { Vec::from_raw_parts(pointer.cast::<KeyValue<'b>>(), 0, capacity) })
+    }
+
+    /// Gets the key-value with the given [`Id`].
+    #[inline]
+    pub fn get(&self, id: Id) -> Option<&KeyValue<'a>> {
+        self.0.get(id.0)
+    }
+
+    /// Gets the key-values specified directly in the given block.
+    pub fn children(&self, at: Id) -> Children<'_, 'a> {
+        let next = if at == Id::ROOT {
+            // The first key-value is always the root's.
+            (!self.0.is_empty()).then_some(Id(0))
+        } else {
+            self.get(at).and_then(|row| row.first_child)
+        };
+        Children {
+            document: self,
+            next,
+        }
+    }
+
     /// Gets the subkeys at the given path.
     pub fn subkeys(&self, at: Id, key: &'a [u8]) -> Option<Id> {
-        let result = self.0.iter().find(|row| row.parent == at && row.key == key);
+        let result = self.children(at).find(|row| row.key == key);
         match result {
             Some(KeyValue {
                 value: Value::Subkeys(sub),
@@ -75,11 +151,8 @@ impl<'a> Document<'a> {
     }
 
     /// Gets the value at the given path.
-    pub fn value_str(&self, at: Id, name: &[u8]) -> Option<&'a [u8]> {
-        let result = self
-            .0
-            .iter()
-            .find(|row| row.parent == at && row.key == name);
+    pub fn value_str(&self, at: Id, name: &[u8]) -> Option<Str<'a>> {
+        let result = self.children(at).find(|row| row.key == name);
         match result {
             Some(KeyValue {
                 value: Value::String(sub),
@@ -90,6 +163,23 @@ impl<'a> Document<'a> {
     }
 }
 
+/// An iterator over a block's key-values, see [`Document::children`].
+#[derive(Debug, Clone)]
+pub struct Children<'d, 'a> {
+    document: &'d Document<'a>,
+    next: Option<Id>,
+}
+
+impl<'d, 'a> Iterator for Children<'d, 'a> {
+    type Item = &'d KeyValue<'a>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let row = self.document.get(self.next?)?;
+        self.next = row.next_sibling;
+        Some(row)
+    }
+}
+
 /// Parse error.
 #[derive(Debug, Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord, thiserror::Error)]
 pub enum Error {
@@ -102,78 +192,364 @@ pub enum Error {
     /// Unexpected EOF after key name.
     #[error("expected key value after key name but reached EOF")]
     ExpectedKeyValueAfterKeyName,
+    /// Unexpected EOF in a block.
+    #[error("expected right brace ('}}') to end the block but reached EOF")]
+    UnterminatedBlock,
 }
 
 /// Removes the first and last characters.
 ///
 /// Useful to remove surrounding characters like quotes.
-fn unsurround(s: &[u8]) -> &[u8] {
+pub(super) fn unsurround(s: &[u8]) -> &[u8] {
     &s[1..s.len() - 1]
 }
 
-#[derive(Debug, Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
-enum ParseOneTerminal {
-    BlockEnd,
-    Eof,
-    Yield,
+/// Appends a key-value to the document, linking it after the previous key-value in its block.
+pub(super) fn push<'a>(
+    document: &mut Document<'a>,
+    previous: &mut Option<Id>,
+    parent: Id,
+    key: &'a [u8],
+    value: impl FnOnce(Id) -> Value<'a>,
+) -> Id {
+    let id = Id(document.0.len());
+    match *previous {
+        Some(previous) => document.0[previous.0].next_sibling = Some(id),
+        None if parent != Id::ROOT => document.0[parent.0].first_child = Some(id),
+        None => {}
+    }
+    *previous = Some(id);
+    document.0.push(KeyValue {
+        parent,
+        key,
+        value: value(id),
+        first_child: None,
+        next_sibling: None,
+    });
+    id
+}
+
+/// Parses a [`Document`].
+#[inline]
+pub fn parse<'a>(tokens: impl Iterator<Item = Token<'a>>) -> Result<Document<'a>, Error> {
+    parse_with_capacity(tokens, 0)
+}
+
+/// Parses a [`Document`], reserving space for the given number of key-values upfront.
+#[inline]
+pub fn parse_with_capacity<'a>(
+    tokens: impl Iterator<Item = Token<'a>>,
+    capacity: usize,
+) -> Result<Document<'a>, Error> {
+    let mut document = Document(Vec::with_capacity(capacity));
+    parse_into(tokens, &mut document)?;
+    Ok(document)
 }
 
-/// Parses a single element.
-fn parse_one<'a>(
-    tokens: &mut impl Iterator<Item = Token<'a>>,
+/// Parses into the given [`Document`], replacing its key-values but reusing its allocation.
+///
+/// On failure, the document is left with the key-values parsed up to the error.
+pub fn parse_into<'a>(
+    mut tokens: impl Iterator<Item = Token<'a>>,
     document: &mut Document<'a>,
-    parent: Id,
-    brace_terminal: bool,
-) -> Result<ParseOneTerminal, Error> {
-    let Some(head) = tokens.next() else { return Ok(ParseOneTerminal::Eof) };
-    match head.r#type {
-        super::TokenType::BraceLeft => Err(Error::UnexpectedBraceLeftNoName),
-        super::TokenType::BraceRight => {
-            if brace_terminal {
-                Ok(ParseOneTerminal::BlockEnd)
-            } else {
-                Err(Error::UnexpectedBraceRightNoMatch)
-            }
-        }
-        super::TokenType::String => {
-            let name = head;
-            let Some(value ) = tokens.next() else { return Err(Error::ExpectedKeyValueAfterKeyName) };
-            match value.r#type {
-                super::TokenType::String => {
-                    document.0.push(KeyValue {
-                        parent,
-                        key: unsurround(name.lexeme),
-                        value: Value::String(unsurround(value.lexeme)),
-                    });
-                    Ok(ParseOneTerminal::Yield)
+) -> Result<(), Error> {
+    document.0.clear();
+    // The current block and the last key-value parsed in it. A block is the last key-value parsed in its parent
+    // block, so the enclosing blocks are found through the parent links rather than a stack.
+    let mut parent = Id::ROOT;
+    let mut previous = None;
+    while let Some(head) = tokens.next() {
+        match head.r#type {
+            super::TokenType::BraceLeft => return Err(Error::UnexpectedBraceLeftNoName),
+            super::TokenType::BraceRight => {
+                if parent == Id::ROOT {
+                    return Err(Error::UnexpectedBraceRightNoMatch);
                 }
-                super::TokenType::BraceLeft => {
-                    let sub_parent = Id(name.lexeme.as_ptr() as usize);
-                    document.0.push(KeyValue {
-                        parent,
-                        key: unsurround(name.lexeme),
-                        value: Value::Subkeys(sub_parent),
-                    });
-                    loop {
-                        let piece = parse_one(tokens, document, sub_parent, true)?;
-                        if piece == ParseOneTerminal::BlockEnd {
-                            break Ok(ParseOneTerminal::Yield);
-                        }
+                previous = Some(parent);
+                parent = document.0[parent.0].parent;
+            }
+            super::TokenType::String => {
+                let key = unsurround(head.lexeme);
+                let value = tokens.next().ok_or(Error::ExpectedKeyValueAfterKeyName)?;
+                match value.r#type {
+                    super::TokenType::String => {
+                        push(document, &mut previous, parent, key, |_| {
+                            Value::String(value.string())
+                        });
+                    }
+                    super::TokenType::BraceLeft => {
+                        parent = push(document, &mut previous, parent, key, Value::Subkeys);
+                        previous = None;
                     }
+                    super::TokenType::BraceRight => return Err(Error::UnexpectedBraceRightNoMatch),
                 }
-                super::TokenType::BraceRight => Err(Error::UnexpectedBraceRightNoMatch),
             }
         }
     }
+    if parent == Id::ROOT {
+        Ok(())
+    } else {
+        Err(Error::UnterminatedBlock)
+    }
 }
 
-/// Parses a [`Document`].
-pub fn parse<'a>(mut tokens: impl Iterator<Item = Token<'a>>) -> Result<Document<'a>, Error> {
-    let mut document = Document::default();
-    loop {
-        if parse_one(&mut tokens, &mut document, Id::ROOT, false)? != ParseOneTerminal::Eof {
-            break;
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::vdf::{
+        scan_parse, scan_parse_into, Event, Reader, ScanError, ScanParseError, Scanner,
+    };
+    use Tree::{Block, Leaf};
+
+    /// A document as a tree, for comparing documents to what they should be.
+    #[derive(Debug, PartialEq, Eq)]
+    enum Tree<'a> {
+        Leaf(&'a [u8]),
+        Block(Vec<(&'a [u8], Tree<'a>)>),
+    }
+
+    /// The tree of a block in a document, checking the block's links along the way.
+    fn document_tree<'a>(document: &Document<'a>, at: Id) -> Vec<(&'a [u8], Tree<'a>)> {
+        document
+            .children(at)
+            .map(|row| {
+                assert_eq!(
+                    row.parent, at,
+                    "{:?} is linked from the wrong block",
+                    row.key
+                );
+                let tree = match row.value {
+                    Value::String(value) => Leaf(value.raw()),
+                    Value::Subkeys(id) => {
+                        assert_eq!(document.get(id), Some(row), "subkeys of another key-value");
+                        assert_eq!(
+                            row.first_child.is_none(),
+                            document.children(id).next().is_none()
+                        );
+                        Block(document_tree(document, id))
+                    }
+                    value => panic!("unexpected value {value:?}"),
+                };
+                (row.key, tree)
+            })
+            .collect()
+    }
+
+    /// The count of key-values in a tree.
+    fn size(tree: &[(&[u8], Tree)]) -> usize {
+        tree.iter()
+            .map(|(_, value)| match value {
+                Leaf(_) => 1,
+                Block(block) => 1 + size(block),
+            })
+            .sum()
+    }
+
+    /// The tree of a document, checking that every key-value is in it.
+    fn tree<'a>(document: &Document<'a>) -> Vec<(&'a [u8], Tree<'a>)> {
+        let tree = document_tree(document, Id::ROOT);
+        assert_eq!(size(&tree), document.0.len(), "unlinked key-values");
+        tree
+    }
+
+    /// The tree of the rest of the block the reader is in.
+    fn reader_block<'a>(
+        reader: &mut Reader<'a>,
+    ) -> Result<Vec<(&'a [u8], Tree<'a>)>, ScanParseError> {
+        let mut block = Vec::new();
+        loop {
+            match reader.next().transpose()? {
+                Some(Event::Enter(key)) => block.push((key, Block(reader_block(reader)?))),
+                Some(Event::KeyValue(key, value)) => block.push((key, Leaf(value.raw()))),
+                Some(Event::Exit) | None => break Ok(block),
+            }
         }
     }
-    Ok(document)
+
+    fn reader_tree(source: &[u8]) -> Result<Vec<(&[u8], Tree<'_>)>, ScanParseError> {
+        let mut reader = Reader::new(source);
+        let tree = reader_block(&mut reader)?;
+        assert_eq!(reader.depth(), 0);
+        assert!(reader.next().is_none(), "events after the end");
+        Ok(tree)
+    }
+
+    /// Checks that every way of parsing the source gives the tree.
+    fn check(source: &str, expected: &[(&[u8], Tree)]) {
+        let source = source.as_bytes();
+        let tokens = || Scanner::new(source).map(Result::unwrap);
+
+        assert_eq!(tree(&parse(tokens()).unwrap()), expected, "parse");
+        assert_eq!(
+            tree(&parse_with_capacity(tokens(), 1).unwrap()),
+            expected,
+            "parse_with_capacity"
+        );
+        assert_eq!(tree(&scan_parse(source).unwrap()), expected, "scan_parse");
+
+        // Over a document holding another source's key-values.
+        let other = br#""other" { "x" "y" }"#.to_vec();
+        let mut document = scan_parse(&other).unwrap();
+        parse_into(tokens(), &mut document).unwrap();
+        assert_eq!(tree(&document), expected, "parse_into");
+        let mut document = document.recycle();
+        scan_parse_into(source, &mut document).unwrap();
+        assert_eq!(tree(&document), expected, "scan_parse_into");
+
+        assert_eq!(reader_tree(source).unwrap(), expected, "Reader");
+    }
+
+    /// Checks that every way of parsing the source fails with the error.
+    fn check_error(source: &str, expected: ScanParseError) {
+        let source = source.as_bytes();
+        assert_eq!(scan_parse(source).err(), Some(expected), "scan_parse");
+        let mut document = Document::default();
+        assert_eq!(
+            scan_parse_into(source, &mut document).err(),
+            Some(expected),
+            "scan_parse_into"
+        );
+        if let ScanParseError::ParseError(expected) = expected {
+            let tokens = Scanner::new(source).map(Result::unwrap);
+            assert_eq!(parse(tokens).err(), Some(expected), "parse");
+        }
+        assert_eq!(reader_tree(source).err(), Some(expected), "Reader");
+    }
+
+    #[test]
+    fn parses_blocks() {
+        check(
+            r#""a" "1" "b" { "c" "2" "d" { } "e" { "f" "3" } "g" "4" } "h" "5""#,
+            &[
+                (b"a", Leaf(b"1")),
+                (
+                    b"b",
+                    Block(vec![
+                        (b"c", Leaf(b"2")),
+                        (b"d", Block(vec![])),
+                        (b"e", Block(vec![(b"f", Leaf(b"3"))])),
+                        (b"g", Leaf(b"4")),
+                    ]),
+                ),
+                (b"h", Leaf(b"5")),
+            ],
+        );
+    }
+
+    #[test]
+    fn parses_as_written() {
+        // Duplicate keys are kept in order, and values are kept escaped.
+        check(
+            "\"users\"\n{\n\t\"1\"\t\t\"a\\\"b\"\n\t\"1\"\t\t\"\\\\\"\n\t\"\"\t\t\"\"\n}\n",
+            &[(
+                b"users",
+                Block(vec![
+                    (b"1", Leaf(br#"a\"b"#)),
+                    (b"1", Leaf(br"\\")),
+                    (b"", Leaf(b"")),
+                ]),
+            )],
+        );
+    }
+
+    #[test]
+    fn parses_empty_sources() {
+        check("", &[]);
+        check(" \t\r\n ", &[]);
+        check(r#""a" {}"#, &[(b"a", Block(vec![]))]);
+    }
+
+    #[test]
+    fn parses_deep_nesting() {
+        const DEPTH: usize = 10_000;
+        let source = format!(
+            "{}\"leaf\" \"1\"{}",
+            "\"k\" {".repeat(DEPTH),
+            "}".repeat(DEPTH)
+        );
+        let document = scan_parse(source.as_bytes()).unwrap();
+        assert_eq!(document.0.len(), DEPTH + 1);
+        // Walked without recursion, which the tree comparison would need.
+        let mut at = Id::ROOT;
+        for i in 0..DEPTH {
+            let row = document.children(at).next().unwrap();
+            assert_eq!(
+                (row.key, row.value, row.parent),
+                (&b"k"[..], Value::Subkeys(Id(i)), at)
+            );
+            assert_eq!(row.next_sibling, None);
+            at = Id(i);
+        }
+        assert_eq!(
+            document.value_str(at, b"leaf").map(Str::raw),
+            Some(&b"1"[..])
+        );
+
+        let mut reader = Reader::new(source.as_bytes());
+        let mut max_depth = 0;
+        while let Some(event) = reader.next() {
+            event.unwrap();
+            max_depth = max_depth.max(reader.depth());
+        }
+        assert_eq!((max_depth, reader.depth()), (DEPTH, 0));
+
+        let unterminated = &source.as_bytes()[..source.len() - 1];
+        assert_eq!(
+            scan_parse(unterminated).err(),
+            Some(Error::UnterminatedBlock.into())
+        );
+        let mut reader = Reader::new(unterminated);
+        assert_eq!(
+            reader.find_map(Result::err),
+            Some(Error::UnterminatedBlock.into())
+        );
+    }
+
+    #[test]
+    fn rejects_unterminated_blocks() {
+        check_error(r#""a" {"#, Error::UnterminatedBlock.into());
+        check_error(r#""a" { "b" "1""#, Error::UnterminatedBlock.into());
+        check_error(r#""a" { "b" { } "c" "1""#, Error::UnterminatedBlock.into());
+    }
+
+    #[test]
+    fn rejects_stray_braces() {
+        check_error("}", Error::UnexpectedBraceRightNoMatch.into());
+        check_error(r#""a" "1" }"#, Error::UnexpectedBraceRightNoMatch.into());
+        check_error(r#""a" { } }"#, Error::UnexpectedBraceRightNoMatch.into());
+        check_error(r#""a" }"#, Error::UnexpectedBraceRightNoMatch.into());
+        check_error("{", Error::UnexpectedBraceLeftNoName.into());
+        check_error(r#""a" { { } }"#, Error::UnexpectedBraceLeftNoName.into());
+        check_error(r#""a""#, Error::ExpectedKeyValueAfterKeyName.into());
+        check_error(r#""a" { "b" }"#, Error::UnexpectedBraceRightNoMatch.into());
+    }
+
+    #[test]
+    fn rejects_unterminated_strings() {
+        check_error(r#""a" "b"#, ScanError::UnterminatedString.into());
+        check_error(r#""a" "b\"#, ScanError::UnterminatedString.into());
+        check_error(r#""a" { "b" "c\"#, ScanError::UnterminatedString.into());
+        check_error(r#""a\"#, ScanError::UnterminatedString.into());
+    }
+
+    #[test]
+    fn recycle_keeps_the_allocation() {
+        let first = br#""a" { "b" "1" "c" "2" }"#.to_vec();
+        let mut document = scan_parse(&first).unwrap();
+        document.0.reserve(100);
+        let (pointer, capacity) = (document.0.as_ptr() as usize, document.0.capacity());
+
+        let second = br#""d" "3""#.to_vec();
+        let mut document = document.recycle();
+        // The recycled document borrows nothing of the first source.
+        drop(first);
+        assert!(document.0.is_empty());
+        assert_eq!(
+            (document.0.as_ptr() as usize, document.0.capacity()),
+            (pointer, capacity)
+        );
+        parse_into(Scanner::new(&second).map(Result::unwrap), &mut document).unwrap();
+        assert_eq!(document.0.as_ptr() as usize, pointer);
+        assert_eq!(tree(&document), [(&b"d"[..], Leaf(b"3"))]);
+    }
 }
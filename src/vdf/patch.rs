@@ -0,0 +1,136 @@
+use std::ops::Range;
+
+/// Edits to a VDF source, which are applied by splicing the changed bytes into a copy of the source.
+///
+/// Unlike serializing a [`Document`](super::parser::Document), the rest of the source is kept byte-for-byte.
+#[derive(Debug, Clone)]
+pub struct Patch<'a> {
+    source: &'a [u8],
+    /// The edits, ordered by their spans, which don't overlap.
+    edits: Vec<(Range<usize>, Vec<u8>)>,
+}
+
+impl<'a> Patch<'a> {
+    /// Creates a new [`Patch`] without edits.
+    #[inline]
+    pub const fn new(source: &'a [u8]) -> Self {
+        Self {
+            source,
+            edits: Vec::new(),
+        }
+    }
+
+    /// The source to be patched.
+    #[inline]
+    pub const fn source(&self) -> &'a [u8] {
+        self.source
+    }
+
+    /// Gets the span of a part of the [source](Self::source), such as a token's lexeme or a value read from it.
+    ///
+    /// # Panics
+    /// If `part` isn't a part of the source.
+    pub fn span(&self, part: &[u8]) -> Range<usize> {
+        let start = (part.as_ptr() as usize).wrapping_sub(self.source.as_ptr() as usize);
+        assert!(
+            start <= self.source.len() && part.len() <= self.source.len() - start,
+            "the part is outside of the source"
+        );
+        start..start + part.len()
+    }
+
+    /// Replaces the bytes in the span.
+    ///
+    /// # Panics
+    /// If the span is out of bounds, or precedes or overlaps the previous edit.
+    pub fn replace(&mut self, span: Range<usize>, bytes: impl Into<Vec<u8>>) {
+        assert!(
+            span.start <= span.end && span.end <= self.source.len(),
+            "the span is out of bounds"
+        );
+        if let Some((previous, _)) = self.edits.last() {
+            assert!(
+                previous.end <= span.start,
+                "edits must be made in order and mustn't overlap"
+            );
+        }
+        self.edits.push((span, bytes.into()));
+    }
+
+    /// Inserts bytes at the position.
+    ///
+    /// # Panics
+    /// If the position is out of bounds, or precedes the previous edit.
+    #[inline]
+    pub fn insert(&mut self, at: usize, bytes: impl Into<Vec<u8>>) {
+        self.replace(at..at, bytes)
+    }
+
+    /// Checks if there are no edits.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.edits.is_empty()
+    }
+
+    /// The length of the patched source.
+    pub fn len(&self) -> usize {
+        self.edits
+            .iter()
+            .fold(self.source.len(), |len, (span, bytes)| {
+                len - span.len() + bytes.len()
+            })
+    }
+
+    /// Appends the patched source to the buffer.
+    pub fn write_to(&self, out: &mut Vec<u8>) {
+        out.reserve(self.len());
+        let mut copied = 0;
+        for (span, bytes) in &self.edits {
+            out.extend_from_slice(&self.source[copied..span.start]);
+            out.extend_from_slice(bytes);
+            copied = span.end;
+        }
+        out.extend_from_slice(&self.source[copied..]);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::Patch;
+
+    fn apply(patch: &Patch) -> Vec<u8> {
+        let mut out = Vec::new();
+        patch.write_to(&mut out);
+        assert_eq!(out.len(), patch.len());
+        out
+    }
+
+    #[test]
+    fn splices_edits() {
+        let source = b"\"a\" \"1\" \"b\" \"22\"";
+        let mut patch = Patch::new(source);
+        assert!(patch.is_empty());
+        assert_eq!(apply(&patch), source);
+
+        patch.insert(0, "// x\n");
+        patch.replace(patch.span(&source[5..6]), "one");
+        patch.replace(patch.span(&source[13..15]), "");
+        patch.insert(source.len(), "\n");
+        assert_eq!(apply(&patch), b"// x\n\"a\" \"one\" \"b\" \"\"\n");
+    }
+
+    #[test]
+    #[should_panic(expected = "in order")]
+    fn edits_must_be_in_order() {
+        let mut patch = Patch::new(b"abcdef");
+        patch.replace(2..4, "x");
+        patch.replace(3..5, "y");
+    }
+
+    #[test]
+    #[should_panic(expected = "outside of the source")]
+    fn spans_must_be_of_the_source() {
+        let other = b"abc".to_vec();
+        Patch::new(b"abcdef").span(&other);
+    }
+}
@@ -0,0 +1,160 @@
+use super::{parser::unsurround, ParseError, ScanParseError, Scanner, Str, TokenType};
+
+/// A [`Reader`] event.
+#[derive(Debug, Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
+pub enum Event<'a> {
+    /// A block of subkeys begins, associated with the given key.
+    Enter(&'a [u8]),
+    /// A key with a string value.
+    KeyValue(&'a [u8], Str<'a>),
+    /// The current block ends.
+    Exit,
+}
+
+/// A streaming VDF reader, which yields [`Event`]s as it scans the source, without building a
+/// [`Document`](super::parser::Document).
+///
+/// The reader stops after the first error.
+#[derive(Debug, Clone)]
+pub struct Reader<'a> {
+    scanner: Scanner<'a>,
+    depth: usize,
+    done: bool,
+}
+
+impl<'a> Reader<'a> {
+    /// Creates a new [`Reader`].
+    #[inline]
+    pub const fn new(source: &'a [u8]) -> Self {
+        Self {
+            scanner: Scanner::new(source),
+            depth: 0,
+            done: false,
+        }
+    }
+
+    /// The number of blocks that are currently open.
+    #[inline]
+    pub const fn depth(&self) -> usize {
+        self.depth
+    }
+
+    /// The position in the source after the last event, e.g. right after the brace that ended a block.
+    #[inline]
+    pub fn position(&self) -> usize {
+        self.scanner.current.min(self.scanner.source.len())
+    }
+
+    /// Skips the rest of the current block, including its end, or the rest of the document at the top level.
+    ///
+    /// The skipped key-values are only scanned, so malformed key-value pairs in them aren't reported.
+    pub fn skip_block(&mut self) -> Result<(), ScanParseError> {
+        if self.done {
+            return Ok(());
+        }
+        let result = self.skip_tokens();
+        if result.is_err() {
+            self.done = true;
+        }
+        result
+    }
+
+    fn skip_tokens(&mut self) -> Result<(), ScanParseError> {
+        let mut open = 0usize;
+        loop {
+            match self.scanner.next().transpose()?.map(|token| token.r#type) {
+                Some(TokenType::BraceLeft) => open += 1,
+                Some(TokenType::BraceRight) if open > 0 => open -= 1,
+                Some(TokenType::BraceRight) => {
+                    self.depth = self
+                        .depth
+                        .checked_sub(1)
+                        .ok_or(ParseError::UnexpectedBraceRightNoMatch)?;
+                    break Ok(());
+                }
+                Some(TokenType::String) => {}
+                None if open == 0 && self.depth == 0 => {
+                    self.done = true;
+                    break Ok(());
+                }
+                None => break Err(ParseError::UnterminatedBlock.into()),
+            }
+        }
+    }
+
+    /// Enters the block at the given path of keys, relative to the current block, skipping the other blocks on the
+    /// way.
+    ///
+    /// Keys are matched ignoring ASCII case, as Steam does, e.g. libraryfolders.vdf's root key was once
+    /// "LibraryFolders" and is now "libraryfolders".
+    ///
+    /// Returns whether the block was found. If it wasn't, the current block has ended.
+    pub fn find_block(&mut self, path: &[&[u8]]) -> Result<bool, ScanParseError> {
+        for &key in path {
+            loop {
+                match self.next().transpose()? {
+                    Some(Event::Enter(name)) if name.eq_ignore_ascii_case(key) => break,
+                    Some(Event::Enter(_)) => self.skip_block()?,
+                    Some(Event::KeyValue(..)) => {}
+                    Some(Event::Exit) | None => return Ok(false),
+                }
+            }
+        }
+        Ok(true)
+    }
+
+    fn read(&mut self) -> Result<Option<Event<'a>>, ScanParseError> {
+        let Some(head) = self.scanner.next().transpose()? else {
+            return if self.depth == 0 {
+                Ok(None)
+            } else {
+                Err(ParseError::UnterminatedBlock.into())
+            };
+        };
+        match head.r#type {
+            TokenType::BraceLeft => Err(ParseError::UnexpectedBraceLeftNoName.into()),
+            TokenType::BraceRight => {
+                self.depth = self
+                    .depth
+                    .checked_sub(1)
+                    .ok_or(ParseError::UnexpectedBraceRightNoMatch)?;
+                Ok(Some(Event::Exit))
+            }
+            TokenType::String => {
+                let key = unsurround(head.lexeme);
+                let Some(value) = self.scanner.next().transpose()? else {
+                    return Err(ParseError::ExpectedKeyValueAfterKeyName.into());
+                };
+                match value.r#type {
+                    TokenType::String => Ok(Some(Event::KeyValue(key, value.string()))),
+                    TokenType::BraceLeft => {
+                        self.depth += 1;
+                        Ok(Some(Event::Enter(key)))
+                    }
+                    TokenType::BraceRight => Err(ParseError::UnexpectedBraceRightNoMatch.into()),
+                }
+            }
+        }
+    }
+}
+
+impl<'a> Iterator for Reader<'a> {
+    type Item = Result<Event<'a>, ScanParseError>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.done {
+            return None;
+        }
+        match self.read() {
+            Ok(Some(event)) => Some(Ok(event)),
+            Ok(None) => {
+                self.done = true;
+                None
+            }
+            Err(e) => {
+                self.done = true;
+                Some(Err(e))
+            }
+        }
+    }
+}
@@ -1,3 +1,5 @@
+use super::{parser::unsurround, Str};
+
 /// A VDF token type.
 #[derive(Debug, Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
 pub enum TokenType {
@@ -16,6 +18,16 @@ pub struct Token<'a> {
     pub r#type: TokenType,
     /// The slice of the token.
     pub lexeme: &'a [u8],
+    /// Whether the token is a string with escape sequences.
+    pub escaped: bool,
+}
+
+impl<'a> Token<'a> {
+    /// Gets a [string](TokenType::String) token's value between its quotes.
+    #[inline]
+    pub fn string(self) -> Str<'a> {
+        Str::with_escaped(unsurround(self.lexeme), self.escaped)
+    }
 }
 
 /// The scanner / lexer data.
@@ -60,18 +72,27 @@ impl<'a> Scanner<'a> {
         Token {
             r#type,
             lexeme: &self.source[self.start..self.current],
+            escaped: false,
         }
     }
 
     fn string_tail(&mut self) -> Result<Token<'a>, Error> {
+        let mut escaped = false;
         loop {
+            self.current = find::quote_or_escape(self.source, self.current);
             let next = self.peek();
             match next {
                 Some(b'"') => {
                     self.current += 1;
-                    break Ok(self.token(TokenType::String));
+                    break Ok(Token {
+                        escaped,
+                        ..self.token(TokenType::String)
+                    });
+                }
+                Some(b'\\') => {
+                    escaped = true;
+                    self.current += 2;
                 }
-                Some(b'\\') => self.current += 2,
                 Some(_) => self.current += 1,
                 None => break Err(Error::UnterminatedString),
             }
@@ -79,6 +100,85 @@ impl<'a> Scanner<'a> {
     }
 }
 
+mod find {
+    //! Byte searches for the [`Scanner`](super::Scanner)'s hot loops, vectorized where available.
+    //!
+    //! Every search starts at `from` and returns the index of the first match, or `from.max(source.len())` if none.
+
+    /// Finds the next string quote (`"`) or escape (`\\`).
+    #[inline]
+    pub fn quote_or_escape(source: &[u8], from: usize) -> usize {
+        #[cfg(target_arch = "x86_64")]
+        let from = sse2::quote_or_escape(source, from);
+        scalar(source, from, |c| matches!(c, b'"' | b'\\'))
+    }
+
+    /// Finds the next non-whitespace byte, per [`u8::is_ascii_whitespace`].
+    #[inline]
+    pub fn non_whitespace(source: &[u8], from: usize) -> usize {
+        #[cfg(target_arch = "x86_64")]
+        let from = sse2::non_whitespace(source, from);
+        scalar(source, from, |c| !c.is_ascii_whitespace())
+    }
+
+    #[inline]
+    pub(super) fn scalar(source: &[u8], from: usize, predicate: impl Fn(u8) -> bool) -> usize {
+        match source.get(from..) {
+            Some(tail) => tail
+                .iter()
+                .position(|&c| predicate(c))
+                .map_or(source.len(), |i| from + i),
+            None => from,
+        }
+    }
+
+    #[cfg(target_arch = "x86_64")]
+    mod sse2 {
+        //! SSE2 is part of the x86-64 baseline, so these need no runtime feature detection.
+        //!
+        //! Each search processes whole 16 byte blocks, and returns where the first block without a full
+        //! result begins, for the scalar search to finish.
+
+        use std::arch::x86_64::*;
+
+        /// Finds the first match in the blocks, where `mask` yields a bitmask of the matching bytes in a block.
+        #[inline(always)]
+        fn search(source: &[u8], mut from: usize, mask: impl Fn(__m128i) -> i32) -> usize {
+            while from + 16 <= source.len() {
+                // SAFETY: the block is within bounds per the loop condition, and SSE2 is always available on x86-64
+                let block = unsafe { _mm_loadu_si128(source.as_ptr().add(from) as *const __m128i) };
+                let matches = mask(block);
+                if matches != 0 {
+                    return from + matches.trailing_zeros() as usize;
+                }
+                from += 16;
+            }
+            from
+        }
+
+        #[inline]
+        pub fn quote_or_escape(source: &[u8], from: usize) -> usize {
+            search(source, from, |block| unsafe {
+                let quotes = _mm_cmpeq_epi8(block, _mm_set1_epi8(b'"' as i8));
+                let escapes = _mm_cmpeq_epi8(block, _mm_set1_epi8(b'\\' as i8));
+                _mm_movemask_epi8(_mm_or_si128(quotes, escapes))
+            })
+        }
+
+        #[inline]
+        pub fn non_whitespace(source: &[u8], from: usize) -> usize {
+            search(source, from, |block| unsafe {
+                let eq = |c: u8| _mm_cmpeq_epi8(block, _mm_set1_epi8(c as i8));
+                let whitespace = _mm_or_si128(
+                    _mm_or_si128(eq(b' '), eq(b'\t')),
+                    _mm_or_si128(_mm_or_si128(eq(b'\n'), eq(b'\x0C')), eq(b'\r')),
+                );
+                !_mm_movemask_epi8(whitespace) & 0xFFFF
+            })
+        }
+    }
+}
+
 /// A [lexing](Scanner) error.
 #[derive(Debug, Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord, thiserror::Error)]
 pub enum Error {
@@ -95,11 +195,11 @@ impl<'a> Iterator for Scanner<'a> {
 
     #[inline]
     fn next(&mut self) -> Option<Self::Item> {
+        self.current = find::non_whitespace(self.source, self.current);
         self.start = self.current;
         let head = self.advance();
         // TODO: comments?
         match head {
-            Some(c) if c.is_ascii_whitespace() => self.next(),
             Some(b'"') => Some(self.string_tail()),
             Some(b'{') => Some(Ok(self.token(TokenType::BraceLeft))),
             Some(b'}') => Some(Ok(self.token(TokenType::BraceRight))),
@@ -108,3 +208,127 @@ impl<'a> Iterator for Scanner<'a> {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::{find, Error, Scanner, Token, TokenType};
+
+    /// A small deterministic PRNG (xorshift64), so the inputs are random but reproducible.
+    fn xorshift(state: &mut u64) -> u64 {
+        *state ^= *state << 13;
+        *state ^= *state >> 7;
+        *state ^= *state << 17;
+        *state
+    }
+
+    /// The bytes the searches look for, and some they don't, weighted towards the former.
+    const ALPHABET: &[u8] = b"\"\\ \t\n\r\x0C\x0Bab{}\0\xFF";
+
+    fn is_quote_or_escape(c: u8) -> bool {
+        matches!(c, b'"' | b'\\')
+    }
+
+    fn is_non_whitespace(c: u8) -> bool {
+        !c.is_ascii_whitespace()
+    }
+
+    /// Checks both searches against the scalar search from every offset, and past the end.
+    fn check(source: &[u8]) {
+        for from in 0..=source.len() + 2 {
+            assert_eq!(
+                find::quote_or_escape(source, from),
+                find::scalar(source, from, is_quote_or_escape),
+                "quote_or_escape({:?}, {from})",
+                source.escape_ascii().to_string(),
+            );
+            assert_eq!(
+                find::non_whitespace(source, from),
+                find::scalar(source, from, is_non_whitespace),
+                "non_whitespace({:?}, {from})",
+                source.escape_ascii().to_string(),
+            );
+        }
+    }
+
+    #[test]
+    fn find_matches_scalar_on_random_inputs() {
+        let mut state = 0x9E37_79B9_7F4A_7C15;
+        for len in 0..=48 {
+            for _ in 0..64 {
+                let source: Vec<u8> = (0..len)
+                    .map(|_| ALPHABET[xorshift(&mut state) as usize % ALPHABET.len()])
+                    .collect();
+                check(&source);
+            }
+        }
+    }
+
+    #[test]
+    fn find_matches_scalar_around_block_boundaries() {
+        for len in 0..=48 {
+            check(&vec![b'a'; len]);
+            check(&vec![b' '; len]);
+            for at in [0, 15, 16, 17, 31, 32, 33] {
+                if at >= len {
+                    continue;
+                }
+                for (fill, c) in [(b'a', b'"'), (b'a', b'\\'), (b' ', b'a'), (b'\t', b'}')] {
+                    let mut source = vec![fill; len];
+                    source[at] = c;
+                    check(&source);
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn find_finds_matches_at_block_boundaries() {
+        for at in [15, 16, 17] {
+            let mut source = vec![b'a'; 48];
+            source[at] = b'"';
+            assert_eq!(find::quote_or_escape(&source, 0), at);
+            assert_eq!(find::quote_or_escape(&source, at + 1), source.len());
+
+            let mut source = vec![b' '; 48];
+            source[at] = b'x';
+            assert_eq!(find::non_whitespace(&source, 0), at);
+            assert_eq!(find::non_whitespace(&source, at + 1), source.len());
+        }
+    }
+
+    fn tokens(source: &[u8]) -> Vec<Result<Token<'_>, Error>> {
+        Scanner::new(source).collect()
+    }
+
+    fn string(lexeme: &[u8], escaped: bool) -> Result<Token<'_>, Error> {
+        Ok(Token {
+            r#type: TokenType::String,
+            lexeme,
+            escaped,
+        })
+    }
+
+    #[test]
+    fn strings_note_escapes() {
+        assert_eq!(tokens(br#""plain""#), [string(br#""plain""#, false)]);
+        assert_eq!(tokens(br#""""#), [string(br#""""#, false)]);
+        assert_eq!(tokens(br#""a\"b""#), [string(br#""a\"b""#, true)]);
+        assert_eq!(tokens(br#""a\\""#), [string(br#""a\\""#, true)]);
+        assert_eq!(tokens(br#""\n""#), [string(br#""\n""#, true)]);
+        // The escape bit is per string, not carried over to the next one.
+        assert_eq!(
+            tokens(br#""a\tb" "c""#),
+            [string(br#""a\tb""#, true), string(br#""c""#, false)]
+        );
+        // Escapes past a block boundary.
+        let long = format!("\"{}\\\"\"", "x".repeat(20));
+        assert_eq!(tokens(long.as_bytes()), [string(long.as_bytes(), true)]);
+    }
+
+    #[test]
+    fn unterminated_strings_are_errors() {
+        assert_eq!(tokens(br#""abc"#), [Err(Error::UnterminatedString)]);
+        assert_eq!(tokens(br#""abc\""#), [Err(Error::UnterminatedString)]);
+        assert_eq!(tokens(br#""abc\"#), [Err(Error::UnterminatedString)]);
+    }
+}
@@ -0,0 +1,157 @@
+use core::fmt::{self, Debug, Formatter};
+use std::borrow::Cow;
+
+/// A VDF string value, as it's written between its quotes.
+///
+/// Escape sequences are left in place, and whether there are any is noted when the string is scanned, so that
+/// [unescaping](Self::unescape) only copies the strings that need it.
+#[derive(Hash, Clone, Copy, PartialEq, PartialOrd, Eq, Ord)]
+pub struct Str<'a> {
+    raw: &'a [u8],
+    escaped: bool,
+}
+
+impl<'a> Str<'a> {
+    /// Creates a [`Str`] from its source between its quotes.
+    #[inline]
+    pub fn new(raw: &'a [u8]) -> Self {
+        Self::with_escaped(raw, raw.contains(&b'\\'))
+    }
+
+    /// Creates a [`Str`] that has no escape sequences, like a binary VDF string.
+    #[inline]
+    pub const fn verbatim(raw: &'a [u8]) -> Self {
+        Self::with_escaped(raw, false)
+    }
+
+    #[inline]
+    pub(super) const fn with_escaped(raw: &'a [u8], escaped: bool) -> Self {
+        Self { raw, escaped }
+    }
+
+    /// The string as it's written, with its escape sequences.
+    #[inline]
+    pub const fn raw(self) -> &'a [u8] {
+        self.raw
+    }
+
+    /// Checks whether the string may have escape sequences, in which case [unescaping](Self::unescape) it copies it.
+    #[inline]
+    pub const fn is_escaped(self) -> bool {
+        self.escaped
+    }
+
+    /// Gets the string's value, borrowing it if it has no escape sequences.
+    ///
+    /// Unknown escape sequences are kept as they are.
+    pub fn unescape(self) -> Cow<'a, [u8]> {
+        if !self.escaped {
+            return Cow::Borrowed(self.raw);
+        }
+        let mut unescaped = Vec::with_capacity(self.raw.len());
+        let mut rest = self.raw;
+        while let Some(at) = rest.iter().position(|&c| c == b'\\') {
+            unescaped.extend_from_slice(&rest[..at]);
+            let Some(&c) = rest.get(at + 1) else {
+                // A trailing backslash, kept as is.
+                rest = &rest[at..];
+                break;
+            };
+            let c = match c {
+                b'n' => b'\n',
+                b't' => b'\t',
+                b'r' => b'\r',
+                b'v' => 0x0B,
+                b'b' => 0x08,
+                b'f' => 0x0C,
+                b'a' => 0x07,
+                b'\\' | b'"' | b'\'' | b'?' => c,
+                _ => {
+                    unescaped.push(b'\\');
+                    c
+                }
+            };
+            unescaped.push(c);
+            rest = &rest[at + 2..];
+        }
+        unescaped.extend_from_slice(rest);
+        Cow::Owned(unescaped)
+    }
+
+    /// Gets the string's value as UTF-8, replacing invalid sequences, and borrowing it if it needs neither
+    /// unescaping nor replacing.
+    pub fn to_string_lossy(self) -> Cow<'a, str> {
+        match self.unescape() {
+            Cow::Borrowed(value) => String::from_utf8_lossy(value),
+            Cow::Owned(value) => match String::from_utf8(value) {
+                Ok(value) => Cow::Owned(value),
+                Err(e) => Cow::Owned(String::from_utf8_lossy(e.as_bytes()).into_owned()),
+            },
+        }
+    }
+}
+
+impl<'a> Debug for Str<'a> {
+    fn fmt(&self, f: &mut Formatter<'_>) -> fmt::Result {
+        write!(f, "\"{}\"", self.raw.escape_ascii())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::Str;
+    use std::borrow::Cow;
+
+    fn unescape(raw: &[u8]) -> Cow<'_, [u8]> {
+        Str::new(raw).unescape()
+    }
+
+    #[test]
+    fn unescapes_escape_sequences() {
+        assert_eq!(unescape(br#"a\"b"#), &b"a\"b"[..]);
+        assert_eq!(unescape(br"a\\b"), &b"a\\b"[..]);
+        assert_eq!(unescape(br"a\nb\tc"), &b"a\nb\tc"[..]);
+        assert_eq!(unescape(br"\r\v\b\f\a\'\?"), &b"\r\x0B\x08\x0C\x07'?"[..]);
+        assert_eq!(unescape(br"\\\\"), &b"\\\\"[..]);
+        assert_eq!(unescape(br#"\\""#), &b"\\\""[..]);
+    }
+
+    #[test]
+    fn keeps_unknown_escapes() {
+        assert_eq!(unescape(br"a\qb"), &b"a\\qb"[..]);
+        assert_eq!(unescape(br"\0\x41"), &b"\\0\\x41"[..]);
+        // A trailing backslash escapes nothing.
+        assert_eq!(unescape(br"ab\"), &b"ab\\"[..]);
+        assert_eq!(unescape(br"\"), &b"\\"[..]);
+        assert_eq!(unescape(br"\n\"), &b"\n\\"[..]);
+    }
+
+    #[test]
+    fn borrows_unescaped_strings() {
+        for raw in [&b""[..], b"plain", "\u{fc}ber".as_bytes()] {
+            let str = Str::new(raw);
+            assert!(!str.is_escaped());
+            assert!(matches!(str.unescape(), Cow::Borrowed(value) if value == raw));
+            assert!(
+                matches!(str.to_string_lossy(), Cow::Borrowed(value) if value.as_bytes() == raw)
+            );
+        }
+        // Verbatim strings aren't unescaped at all.
+        let verbatim = Str::verbatim(br"a\nb");
+        assert!(matches!(verbatim.unescape(), Cow::Borrowed(br"a\nb")));
+        assert!(matches!(verbatim.to_string_lossy(), Cow::Borrowed(r"a\nb")));
+    }
+
+    #[test]
+    fn converts_to_strings_lossily() {
+        assert!(
+            matches!(Str::new(br#"\"hi\""#).to_string_lossy(), Cow::Owned(value) if value == "\"hi\"")
+        );
+        assert_eq!(Str::new(b"a\xFFb").to_string_lossy(), "a\u{FFFD}b");
+        assert_eq!(Str::new(b"\\t\xFF").to_string_lossy(), "\t\u{FFFD}");
+        assert_eq!(
+            Str::new("\\\"\u{fc}\\\"".as_bytes()).to_string_lossy(),
+            "\"\u{fc}\""
+        );
+    }
+}
@@ -0,0 +1,102 @@
+//! Watching Steam's files for changes.
+
+use std::{
+    ffi::{c_void, OsStr},
+    fmt::Debug,
+    os::windows::prelude::OsStrExt,
+    ptr::NonNull,
+    time::Duration,
+};
+
+use winapi::{ctypes::wchar_t, shared::minwindef::DWORD};
+
+use crate::{
+    steam::{err_opt, timeout_ms, CResult, Result},
+    Steam,
+};
+
+/// Reflects `windows.c`'s `steam_watch_t`, which is opaque.
+type CWatch = c_void;
+
+/// Watches a directory in the Steam directory for changes to its files.
+///
+/// Changes are queued from the watcher's creation on, so none are missed between [waits](Self::wait).
+pub struct Watcher(NonNull<CWatch>);
+
+// SAFETY: the watch is only used through `&mut self`, and is only freed on drop.
+unsafe impl Send for Watcher {}
+
+impl Watcher {
+    /// Starts watching the directory, which is relative to the Steam directory, e.g. `config`.
+    pub fn new(steam: &Steam, subdir: impl AsRef<OsStr>) -> Result<Self> {
+        let subdir = wide(subdir.as_ref());
+        let mut watch = std::ptr::null_mut();
+        err_opt(
+            unsafe { steam_watch_start(steam, subdir.as_ptr(), &mut watch) }.into(),
+            (),
+        )?;
+        Ok(Self(
+            NonNull::new(watch).expect("steam_watch_start succeeded without a watch"),
+        ))
+    }
+
+    /// Waits until the file changes.
+    ///
+    /// Returns whether it may have changed before the timeout ([`None`] waits indefinitely).
+    /// It may also report a change when there were more changes than the system could queue.
+    pub fn wait(
+        &mut self,
+        file_name: impl AsRef<OsStr>,
+        timeout: Option<Duration>,
+    ) -> Result<bool> {
+        let file_name = wide(file_name.as_ref());
+        let mut changed = 0u8;
+        err_opt(
+            unsafe {
+                steam_watch_wait(
+                    self.0.as_ptr(),
+                    file_name.as_ptr(),
+                    timeout_ms(timeout),
+                    &mut changed,
+                )
+            }
+            .into(),
+            changed != 0,
+        )
+    }
+}
+
+/// Encodes the string as a NUL-terminated wide string.
+fn wide(s: &OsStr) -> Vec<wchar_t> {
+    s.encode_wide().chain(std::iter::once(0)).collect()
+}
+
+impl Drop for Watcher {
+    #[inline]
+    fn drop(&mut self) {
+        unsafe { steam_watch_free(self.0.as_ptr()) }
+    }
+}
+
+impl Debug for Watcher {
+    #[inline]
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_tuple("Watcher").finish()
+    }
+}
+
+#[link(name = "windowsutil")]
+extern "C" {
+    fn steam_watch_start(
+        steam: *const Steam,
+        subdir: *const wchar_t,
+        watch: *mut *mut CWatch,
+    ) -> CResult;
+    fn steam_watch_free(watch: *mut CWatch);
+    fn steam_watch_wait(
+        watch: *mut CWatch,
+        name: *const wchar_t,
+        timeout_ms: DWORD,
+        changed: *mut u8,
+    ) -> CResult;
+}
@@ -1,9 +1,12 @@
 #include <stdint.h>
 #include <Windows.h>
+#include <winternl.h>
 #include <Psapi.h>
 #include <Shlwapi.h>
+#include <sddl.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 // note: on change, sync the Phase enum in steam.rs
 typedef enum {
@@ -15,6 +18,11 @@ typedef enum {
     ENUM_PROCESSES,
     KILL_STEAM,
     OPEN_VDF,
+    WAIT_STEAM_LOGIN,
+    READ_VDF,
+    WRITE_VDF,
+    PIPE,
+    WATCH,
 } phase_t;
 
 typedef struct {
@@ -25,86 +33,228 @@ typedef struct {
 #define SUCCESS ((result_t){OK,ERROR_SUCCESS})
 #define FAILURE(type) ((result_t){type,GetLastError()})
 
+/// the number of phases, for arrays indexed by phase_t.
+#define PHASE_COUNT (WATCH + 1)
+
+/// where the calls into this file spent their time, and how much work they did.
+/// a phase's time is that of the system calls that do its work, so phases don't overlap.
+/// the pipe and the watcher only wait for clients and changes, so they aren't timed.
+/// note: on change, sync the CStats struct in stats.rs.
+typedef struct {
+    /// the time spent in each phase's system calls, in QueryPerformanceCounter ticks.
+    LONG64 ticks[PHASE_COUNT];
+    /// the number of timed system calls in each phase.
+    LONG calls[PHASE_COUNT];
+    /// processes looked at in system process snapshots.
+    LONG processes_scanned;
+    /// processes opened, to check whether they're Steam's or to wait on them.
+    LONG processes_opened;
+    /// processes terminated.
+    LONG processes_terminated;
+} steam_stats_t;
+
+/// the stats since the last steam_stats_take.
+/// updated atomically, since Steam's processes are also tracked from the thread pool.
+static steam_stats_t stats;
+
+/// marks the start of a system call, see stats_time.
+static LONG64 stats_start(void) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+/// adds the time since stats_start to the phase.
+/// note: keeps the last error, so it can come between a system call and FAILURE.
+static void stats_time(phase_t phase, LONG64 start) {
+    const DWORD error = GetLastError();
+    InterlockedExchangeAdd64(&stats.ticks[phase], stats_start() - start);
+    InterlockedIncrement(&stats.calls[phase]);
+    SetLastError(error);
+}
+
+static void stats_count(LONG volatile *counter, size_t n) {
+    InterlockedExchangeAdd(counter, (LONG)n);
+}
+
+/// moves the stats into out, starting them over.
+/// @param frequency set to the QueryPerformanceCounter frequency, in ticks per second.
+void steam_stats_take(steam_stats_t *out, LONG64 *frequency) {
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        out->ticks[i] = InterlockedExchange64(&stats.ticks[i], 0);
+        out->calls[i] = InterlockedExchange(&stats.calls[i], 0);
+    }
+    out->processes_scanned = InterlockedExchange(&stats.processes_scanned, 0);
+    out->processes_opened = InterlockedExchange(&stats.processes_opened, 0);
+    out->processes_terminated = InterlockedExchange(&stats.processes_terminated, 0);
+    LARGE_INTEGER ticks_per_second;
+    QueryPerformanceFrequency(&ticks_per_second);
+    *frequency = ticks_per_second.QuadPart;
+}
+
 typedef struct {
     /// path length excluding NUL terminator.
     wchar_t len;
     /// lowercase path to the steam executable.
     wchar_t path[MAX_PATH];
+    /// Steam's registry key, opened once and reused for every registry read and write.
+    HKEY key;
 } steam_t;
 
+/// Steam's registry key, under HKEY_CURRENT_USER.
+#define STEAM_KEY L"SOFTWARE\\Valve\\Steam"
+
+/// note: release the steam with steam_free after use.
 result_t steam_init(steam_t *steam) {
+    const LONG64 open_start = stats_start();
+    const LSTATUS open_status = RegOpenKeyExW(
+        HKEY_CURRENT_USER,
+        STEAM_KEY,
+        0,
+        KEY_QUERY_VALUE | KEY_SET_VALUE | KEY_NOTIFY,
+        &steam->key
+    );
+    stats_time(READ_STEAM_REGISTRY, open_start);
+    if (open_status != ERROR_SUCCESS) {
+        steam->key = NULL;
+        return (result_t){READ_STEAM_REGISTRY, (DWORD)open_status};
+    }
     DWORD size = sizeof(steam->path);
+    const LONG64 get_start = stats_start();
     const LSTATUS status = RegGetValueW(
-        HKEY_CURRENT_USER,
-        L"SOFTWARE\\Valve\\Steam",
+        steam->key,
+        NULL,
         L"SteamExe",
         RRF_RT_REG_SZ,
         NULL,
         &steam->path,
         &size
     );
-    if (status != ERROR_SUCCESS) return (result_t){READ_STEAM_REGISTRY, status};
+    stats_time(READ_STEAM_REGISTRY, get_start);
+    if (status != ERROR_SUCCESS) {
+        RegCloseKey(steam->key);
+        steam->key = NULL;
+        return (result_t){READ_STEAM_REGISTRY, status};
+    }
     steam->len = (wchar_t)(size / sizeof(wchar_t) - /* NUL */ 1);
     for (size_t i = 0; i < steam->len; i++)
         steam->path[i] = steam->path[i] == '/' ? '\\' : towlower(steam->path[i]);
     return SUCCESS;
 }
 
+void steam_free(steam_t *steam) {
+    if (steam->key) RegCloseKey(steam->key);
+    steam->key = NULL;
+}
+
+/// the name of the job object that steam_launch_job launches Steam in.
+/// a job's name only lives as long as a handle to it, so Steam inherits one to keep it alive while it runs.
+#define STEAM_JOB_NAME L"Local\\diverter.steam"
+
 /// note 1: close the handles to the process info's process and thread after their use.
 /// note 2: args needs to be writable.
-static result_t steam_launch_args(steam_t const *steam, wchar_t *args, PROCESS_INFORMATION *process) {
-    STARTUPINFOW startup = {0};
-    startup.cb = sizeof(startup);
+/// note 3: job is optional, when given, the process is assigned to it and inherits its handle.
+static result_t steam_launch_args(steam_t const *steam, wchar_t *args, HANDLE job, PROCESS_INFORMATION *process) {
+    *process = (PROCESS_INFORMATION){0};
+    STARTUPINFOEXW startup = {0};
+    startup.StartupInfo.cb = sizeof(startup.StartupInfo);
+    DWORD flags = CREATE_NEW_PROCESS_GROUP;
+    if (job) {
+        SIZE_T attributes_size = 0;
+        InitializeProcThreadAttributeList(NULL, 1, 0, &attributes_size);
+        startup.lpAttributeList = malloc(attributes_size);
+        if (startup.lpAttributeList == NULL) return (result_t){LAUNCH_STEAM, ERROR_NOT_ENOUGH_MEMORY};
+        if (!InitializeProcThreadAttributeList(startup.lpAttributeList, 1, 0, &attributes_size)) {
+            const result_t failure = FAILURE(LAUNCH_STEAM);
+            free(startup.lpAttributeList);
+            return failure;
+        }
+        if (!UpdateProcThreadAttribute(startup.lpAttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &job, sizeof(job), NULL, NULL)) {
+            const result_t failure = FAILURE(LAUNCH_STEAM);
+            DeleteProcThreadAttributeList(startup.lpAttributeList);
+            free(startup.lpAttributeList);
+            return failure;
+        }
+        startup.StartupInfo.cb = sizeof(startup);
+        flags |= EXTENDED_STARTUPINFO_PRESENT | CREATE_SUSPENDED;
+    }
+    const LONG64 start = stats_start();
     const BOOL launched = CreateProcessW(
         steam->path,
         args,
         NULL, NULL,
-        FALSE,
-        CREATE_NEW_PROCESS_GROUP,
+        job != NULL,
+        flags,
         NULL,
         NULL,
-        &startup,
+        &startup.StartupInfo,
         process
     );
-    return launched ? SUCCESS : (result_t){LAUNCH_STEAM, GetLastError()};
+    stats_time(LAUNCH_STEAM, start);
+    const result_t result = launched ? SUCCESS : (result_t){LAUNCH_STEAM, GetLastError()};
+    if (job) {
+        DeleteProcThreadAttributeList(startup.lpAttributeList);
+        free(startup.lpAttributeList);
+        if (launched) {
+            // if the assignment fails Steam still runs, and is found by scanning instead.
+            AssignProcessToJobObject(job, process->hProcess);
+            ResumeThread(process->hThread);
+        }
+    }
+    return result;
 }
 
-result_t steam_shutdown(steam_t const *steam) {
+// the flag is passed twice, because passing it once doesn't seem to work.
+// this might be because perhaps Steam ignores the first argument, expecting it to be its executable path.
+#define STEAM_ARGS_FAST L"-noverifyfiles -noverifyfiles"
+
+result_t steam_launch(steam_t const *steam) {
     PROCESS_INFORMATION process;
-    wchar_t args[] = L"-shutdown";
-    const result_t launch_result = steam_launch_args(steam, args, &process);
-    if (launch_result.type != OK && process.hProcess) {
-        CloseHandle(process.hThread);
-        CloseHandle(process.hProcess);
-        return launch_result;
-    }
-    DWORD wait_result = WaitForSingleObject(process.hProcess, INFINITE);
+    const result_t result = steam_launch_args(steam, NULL, NULL, &process);
     CloseHandle(process.hThread);
     CloseHandle(process.hProcess);
-    return wait_result == WAIT_FAILED
-        ? (result_t){WAIT_STEAM_EXIT, GetLastError()}
-        : SUCCESS;
+    return result;
 }
 
-result_t steam_launch(steam_t const *steam) {
+result_t steam_launch_fast(steam_t const *steam) {
     PROCESS_INFORMATION process;
-    const result_t result = steam_launch_args(steam, NULL, &process);
+    wchar_t args[] = STEAM_ARGS_FAST;
+    const result_t result = steam_launch_args(steam, args, NULL, &process);
     CloseHandle(process.hThread);
     CloseHandle(process.hProcess);
     return result;
 }
 
-result_t steam_launch_fast(steam_t const *steam) {
+/// launches Steam in a named job object, so it can be killed and checked without scanning processes.
+result_t steam_launch_job(steam_t const *steam, uint8_t verify) {
+    SECURITY_ATTRIBUTES inheritable = {sizeof(inheritable), NULL, TRUE};
+    const HANDLE job = CreateJobObjectW(&inheritable, STEAM_JOB_NAME);
+    if (job == NULL) return FAILURE(LAUNCH_STEAM);
     PROCESS_INFORMATION process;
-    wchar_t args[] = L"-noverifyfiles -noverifyfiles";
-    // the flag is passed twice, because passing it once doesn't seem to work.
-    // this might be because perhaps Steam ignores the first argument, expecting it to be its executable path.
-    const result_t result = steam_launch_args(steam, args, &process);
+    wchar_t args[] = STEAM_ARGS_FAST;
+    const result_t result = steam_launch_args(steam, verify ? NULL : args, job, &process);
     CloseHandle(process.hThread);
     CloseHandle(process.hProcess);
+    CloseHandle(job);
     return result;
 }
 
+/// opens the job object that steam_launch_job launched Steam in, if Steam is still alive in it.
+/// note: close the handle after use.
+static HANDLE steam_job_open(DWORD access) {
+    const HANDLE job = OpenJobObjectW(access | JOB_OBJECT_QUERY, FALSE, STEAM_JOB_NAME);
+    if (job == NULL) return NULL;
+    JOBOBJECT_BASIC_ACCOUNTING_INFORMATION info;
+    if (
+        !QueryInformationJobObject(job, JobObjectBasicAccountingInformation, &info, sizeof(info), NULL) ||
+        info.ActiveProcesses == 0
+    ) {
+        CloseHandle(job);
+        return NULL;
+    }
+    return job;
+}
+
 /// @return dir length, excluding NUL
 static size_t steam_dir_lowercase(steam_t const *steam, wchar_t out[MAX_PATH]) {
     const size_t dir_len = steam->len - (sizeof("steam.exe") - /* NUL */ 1);
@@ -120,22 +270,141 @@ static uint8_t steam_path_is_ancestor(wchar_t* path, size_t path_len, const wcha
     return 1;
 }
 
+#define STATUS_INFO_LENGTH_MISMATCH ((NTSTATUS)0xC0000004L)
+
+/// image names of the processes that make up the Steam client.
+/// used to pre-filter the process snapshot so only a handful of processes are opened.
+static const wchar_t *const steam_image_names[] = {
+    L"steam.exe",
+    L"steamwebhelper.exe",
+    L"steamservice.exe",
+    L"steamerrorreporter.exe",
+    L"steamerrorreporter64.exe",
+    L"steamsysinfo.exe",
+    L"steamxboxutil.exe",
+    L"steamxboxutil64.exe",
+    L"gldriverquery.exe",
+    L"gldriverquery64.exe",
+    L"vulkandriverquery.exe",
+    L"vulkandriverquery64.exe",
+    L"x86launcher.exe",
+    L"x64launcher.exe",
+};
+
+static uint8_t steam_image_name_matches(UNICODE_STRING const *name) {
+    if (name->Buffer == NULL) return 0;
+    const size_t name_len = name->Length / sizeof(wchar_t);
+    for (size_t i = 0; i < sizeof(steam_image_names) / sizeof(*steam_image_names); i++)
+        if (wcslen(steam_image_names[i]) == name_len && _wcsnicmp(name->Buffer, steam_image_names[i], name_len) == 0)
+            return 1;
+    return 0;
+}
+
+static SYSTEM_PROCESS_INFORMATION const *process_snapshot_next(SYSTEM_PROCESS_INFORMATION const *process) {
+    return process->NextEntryOffset
+        ? (SYSTEM_PROCESS_INFORMATION const *)((BYTE const *)process + process->NextEntryOffset)
+        : NULL;
+}
+
+static uint8_t pids_contain(DWORD const *pids, size_t len, DWORD pid) {
+    for (size_t i = 0; i < len; i++)
+        if (pids[i] == pid) return 1;
+    return 0;
+}
+
+/// note 1: zero-initialize before the first steam_process_iter_init.
+/// note 2: the buffers are reused across steam_process_iter_init calls, free them with steam_process_iter_free.
 typedef struct {
-    DWORD pids[5000];
-    uint16_t len;
-    uint16_t index;
+    /// candidate PIDs, by image name or by descent from a candidate.
+    DWORD *pids;
+    size_t len;
+    size_t capacity;
+    size_t index;
+    /// the system process snapshot buffer.
+    SYSTEM_PROCESS_INFORMATION *snapshot;
+    ULONG snapshot_size;
     const wchar_t *dir;
     size_t dir_len;
 } steam_process_iter_t;
 
+void steam_process_iter_free(steam_process_iter_t *iter) {
+    free(iter->pids);
+    free(iter->snapshot);
+    iter->pids = NULL;
+    iter->len = iter->capacity = iter->index = 0;
+    iter->snapshot = NULL;
+    iter->snapshot_size = 0;
+}
+
+/// takes a snapshot of all the processes in the system with a single system call.
+/// the snapshot buffer is grown until the snapshot fits, and kept for the next snapshot.
+static DWORD steam_process_iter_snapshot(steam_process_iter_t *iter) {
+    for (;;) {
+        if (iter->snapshot == NULL) {
+            if (iter->snapshot_size == 0) iter->snapshot_size = 256 * 1024;
+            iter->snapshot = malloc(iter->snapshot_size);
+            if (iter->snapshot == NULL) return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        ULONG required = 0;
+        const LONG64 start = stats_start();
+        const NTSTATUS status = NtQuerySystemInformation(SystemProcessInformation, iter->snapshot, iter->snapshot_size, &required);
+        stats_time(ENUM_PROCESSES, start);
+        if (status >= 0) return ERROR_SUCCESS;
+        if (status != STATUS_INFO_LENGTH_MISMATCH) return RtlNtStatusToDosError(status);
+        // the buffer is too small (the snapshot would be truncated), retry with a bigger one.
+        // processes may spawn between the calls, so leave some slack.
+        free(iter->snapshot);
+        iter->snapshot = NULL;
+        const ULONG grown = required + required / 8;
+        iter->snapshot_size = grown > iter->snapshot_size ? grown : iter->snapshot_size * 2;
+    }
+}
+
+static DWORD steam_process_iter_push(steam_process_iter_t *iter, DWORD pid) {
+    if (iter->len == iter->capacity) {
+        const size_t capacity = iter->capacity ? iter->capacity * 2 : 64;
+        DWORD *pids = realloc(iter->pids, capacity * sizeof(DWORD));
+        if (pids == NULL) return ERROR_NOT_ENOUGH_MEMORY;
+        iter->pids = pids;
+        iter->capacity = capacity;
+    }
+    iter->pids[iter->len++] = pid;
+    return ERROR_SUCCESS;
+}
+
+/// snapshots the system's processes and keeps the ones that are likely to be Steam's.
+/// only the candidates are opened and have their path checked by steam_process_iter_next.
 DWORD steam_process_iter_init(steam_process_iter_t *iter, wchar_t* steam_dir, size_t steam_dir_len) {
-    DWORD bytes_len = 0;
-    if (!EnumProcesses(iter->pids, sizeof(iter->pids), &bytes_len))
-        return GetLastError();
+    const DWORD snapshot_result = steam_process_iter_snapshot(iter);
+    if (snapshot_result != ERROR_SUCCESS) return snapshot_result;
+
+    iter->len = 0;
     iter->index = 0;
-    iter->len = (uint16_t)(bytes_len / sizeof(DWORD));
     iter->dir = steam_dir;
     iter->dir_len = steam_dir_len;
+    size_t scanned = 0;
+    for (SYSTEM_PROCESS_INFORMATION const *process = iter->snapshot; process; process = process_snapshot_next(process)) {
+        scanned++;
+        if (steam_image_name_matches(&process->ImageName)) {
+            const DWORD push_result = steam_process_iter_push(iter, (DWORD)(ULONG_PTR)process->UniqueProcessId);
+            if (push_result != ERROR_SUCCESS) return push_result;
+        }
+    }
+    stats_count(&stats.processes_scanned, scanned);
+
+    // descendants of candidates (e.g. games launched by Steam) are candidates as well.
+    for (size_t found = iter->len; found;) {
+        found = 0;
+        for (SYSTEM_PROCESS_INFORMATION const *process = iter->snapshot; process; process = process_snapshot_next(process)) {
+            const DWORD pid = (DWORD)(ULONG_PTR)process->UniqueProcessId;
+            const DWORD parent = (DWORD)(ULONG_PTR)process->Reserved2; // InheritedFromUniqueProcessId
+            if (pid && pids_contain(iter->pids, iter->len, parent) && !pids_contain(iter->pids, iter->len, pid)) {
+                const DWORD push_result = steam_process_iter_push(iter, pid);
+                if (push_result != ERROR_SUCCESS) return push_result;
+                found++;
+            }
+        }
+    }
     return ERROR_SUCCESS;
 }
 
@@ -148,11 +417,18 @@ typedef struct {
 steam_process_t steam_process_iter_next(steam_process_iter_t *iter) {
     for (; iter->index < iter->len; iter->index++) {
         const DWORD pid = iter->pids[iter->index];
-        const HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_TERMINATE, FALSE, pid);
-        if (process == NULL) continue;
+        const LONG64 start = stats_start();
+        const HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_TERMINATE | SYNCHRONIZE, FALSE, pid);
+        if (process == NULL) {
+            stats_time(ENUM_PROCESSES, start);
+            continue;
+        }
+        stats_count(&stats.processes_opened, 1);
         wchar_t path[MAX_PATH];
         DWORD path_len = sizeof(path) / sizeof(wchar_t);
-        if (!QueryFullProcessImageNameW(process, 0, path, &path_len)) goto next_process;
+        const BOOL queried = QueryFullProcessImageNameW(process, 0, path, &path_len);
+        stats_time(ENUM_PROCESSES, start);
+        if (!queried) goto next_process;
         if (steam_path_is_ancestor(path, path_len, iter->dir, iter->dir_len)) {
             iter->index++;
             return (steam_process_t){pid,process};
@@ -163,62 +439,341 @@ steam_process_t steam_process_iter_next(steam_process_iter_t *iter) {
     return (steam_process_t){0,0};
 }
 
-result_t steam_kill(steam_t const *steam, uint8_t killed) {
+/// a growable set of process handles.
+typedef struct {
+    HANDLE *handles;
+    size_t len;
+    size_t capacity;
+} handles_t;
+
+static DWORD handles_push(handles_t *set, HANDLE handle) {
+    if (set->len == set->capacity) {
+        const size_t capacity = set->capacity ? set->capacity * 2 : MAXIMUM_WAIT_OBJECTS;
+        HANDLE *handles = realloc(set->handles, capacity * sizeof(HANDLE));
+        if (handles == NULL) return ERROR_NOT_ENOUGH_MEMORY;
+        set->handles = handles;
+        set->capacity = capacity;
+    }
+    set->handles[set->len++] = handle;
+    return ERROR_SUCCESS;
+}
+
+/// closes the handles in the set, keeping its buffer for reuse.
+static void handles_close(handles_t *set) {
+    for (size_t i = 0; i < set->len; i++) CloseHandle(set->handles[i]);
+    set->len = 0;
+}
+
+static void handles_free(handles_t *set) {
+    handles_close(set);
+    free(set->handles);
+    set->handles = NULL;
+    set->capacity = 0;
+}
+
+#define DEADLINE_NEVER ((ULONGLONG)-1)
+
+static ULONGLONG deadline_from_timeout(DWORD timeout_ms) {
+    return timeout_ms == INFINITE ? DEADLINE_NEVER : GetTickCount64() + timeout_ms;
+}
+
+static DWORD deadline_remaining(ULONGLONG deadline) {
+    if (deadline == DEADLINE_NEVER) return INFINITE;
+    const ULONGLONG now = GetTickCount64();
+    if (now >= deadline) return 0;
+    const ULONGLONG remaining = deadline - now;
+    return remaining < INFINITE ? (DWORD)remaining : INFINITE - 1;
+}
+
+/// waits for all the handles in the set, MAXIMUM_WAIT_OBJECTS at a time.
+/// @return WAIT_OBJECT_0, WAIT_TIMEOUT or WAIT_FAILED.
+static DWORD handles_wait_all(handles_t const *set, ULONGLONG deadline) {
+    for (size_t i = 0; i < set->len; i += MAXIMUM_WAIT_OBJECTS) {
+        const size_t chunk = set->len - i < MAXIMUM_WAIT_OBJECTS ? set->len - i : MAXIMUM_WAIT_OBJECTS;
+        const LONG64 start = stats_start();
+        const DWORD wait = WaitForMultipleObjects((DWORD)chunk, &set->handles[i], TRUE, deadline_remaining(deadline));
+        stats_time(WAIT_STEAM_EXIT, start);
+        if (wait == WAIT_TIMEOUT || wait == WAIT_FAILED) return wait;
+    }
+    return WAIT_OBJECT_0;
+}
+
+/// waits for the handles in the set, see handles_wait_all.
+/// @param done set to whether all the handles were signaled (i.e. the wait didn't time out).
+result_t steam_handles_wait(handles_t const *set, DWORD timeout_ms, uint8_t *done) {
+    const DWORD wait = handles_wait_all(set, deadline_from_timeout(timeout_ms));
+    *done = wait == WAIT_OBJECT_0;
+    return wait == WAIT_FAILED ? FAILURE(WAIT_STEAM_EXIT) : SUCCESS;
+}
+
+void steam_handles_free(handles_t *set) {
+    handles_free(set);
+}
+
+/// launches Steam's -shutdown helper without waiting for it.
+/// @param helper receives the helper's process handle, which is signaled once the shutdown request is delivered.
+result_t steam_shutdown_start(steam_t const *steam, handles_t *helper) {
+    PROCESS_INFORMATION process;
+    wchar_t args[] = L"-shutdown";
+    const result_t launch_result = steam_launch_args(steam, args, NULL, &process);
+    if (launch_result.type != OK) return launch_result;
+    CloseHandle(process.hThread);
+    const DWORD push_result = handles_push(helper, process.hProcess);
+    if (push_result != ERROR_SUCCESS) {
+        CloseHandle(process.hProcess);
+        return (result_t){LAUNCH_STEAM, push_result};
+    }
+    return SUCCESS;
+}
+
+result_t steam_shutdown(steam_t const *steam) {
+    handles_t helper = {0};
+    const result_t launch_result = steam_shutdown_start(steam, &helper);
+    if (launch_result.type != OK) return launch_result;
+    const DWORD wait_result = handles_wait_all(&helper, DEADLINE_NEVER);
+    const result_t result = wait_result == WAIT_FAILED ? FAILURE(WAIT_STEAM_EXIT) : SUCCESS;
+    handles_free(&helper);
+    return result;
+}
+
+/// collects SYNCHRONIZE handles to the job's processes.
+static DWORD steam_job_handles(HANDLE job, handles_t *set) {
+    size_t capacity = 64;
+    for (;;) {
+        const DWORD size = (DWORD)(sizeof(JOBOBJECT_BASIC_PROCESS_ID_LIST) + capacity * sizeof(ULONG_PTR));
+        JOBOBJECT_BASIC_PROCESS_ID_LIST *list = malloc(size);
+        if (list == NULL) return ERROR_NOT_ENOUGH_MEMORY;
+        if (!QueryInformationJobObject(job, JobObjectBasicProcessIdList, list, size, NULL)) {
+            const DWORD error = GetLastError();
+            const size_t assigned = list->NumberOfAssignedProcesses;
+            free(list);
+            if (error != ERROR_MORE_DATA) return error;
+            capacity = assigned > capacity ? assigned : capacity * 2;
+            continue;
+        }
+        DWORD result = ERROR_SUCCESS;
+        for (DWORD i = 0; i < list->NumberOfProcessIdsInList && result == ERROR_SUCCESS; i++) {
+            const HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)list->ProcessIdList[i]);
+            if (process == NULL) continue; // already gone
+            stats_count(&stats.processes_opened, 1);
+            result = handles_push(set, process);
+            if (result != ERROR_SUCCESS) CloseHandle(process);
+        }
+        free(list);
+        return result;
+    }
+}
+
+/// terminates all Steam processes without waiting for them to exit.
+/// @param exiting receives handles to the terminated processes, which are signaled once they exit.
+/// @param killed set to whether any process was terminated.
+result_t steam_kill_start(steam_t const *steam, handles_t *exiting, uint8_t *killed) {
+    *killed = 0;
+    const HANDLE job = steam_job_open(JOB_OBJECT_TERMINATE);
+    if (job) {
+        const DWORD handles_result = steam_job_handles(job, exiting);
+        if (handles_result != ERROR_SUCCESS) {
+            CloseHandle(job);
+            return (result_t){ENUM_PROCESSES, handles_result};
+        }
+        const LONG64 start = stats_start();
+        const BOOL terminated = TerminateJobObject(job, EXIT_SUCCESS);
+        stats_time(KILL_STEAM, start);
+        const result_t result = terminated ? SUCCESS : FAILURE(KILL_STEAM);
+        CloseHandle(job);
+        if (terminated) {
+            *killed = 1;
+            stats_count(&stats.processes_terminated, exiting->len);
+        }
+        return result;
+    }
+
     wchar_t dir[MAX_PATH];
     const size_t dir_len = steam_dir_lowercase(steam, dir);
 
-    steam_process_iter_t iter;
+    steam_process_iter_t iter = {0};
     DWORD iter_result = steam_process_iter_init(&iter, dir, dir_len);
-    if (iter_result != ERROR_SUCCESS) return (result_t){ENUM_PROCESSES, iter_result};
+    if (iter_result != ERROR_SUCCESS) {
+        steam_process_iter_free(&iter);
+        return (result_t){ENUM_PROCESSES, iter_result};
+    }
 
+    result_t result = SUCCESS;
     for (steam_process_t process = steam_process_iter_next(&iter); process.pid != 0; process = steam_process_iter_next(&iter)) {
-        if (TerminateProcess(process.handle, EXIT_SUCCESS)) {
+        const LONG64 start = stats_start();
+        const BOOL terminated = TerminateProcess(process.handle, EXIT_SUCCESS);
+        stats_time(KILL_STEAM, start);
+        if (!terminated) {
+            result = FAILURE(KILL_STEAM);
             CloseHandle(process.handle);
-            killed = 1;
-        } else {
+            break;
+        }
+        *killed = 1;
+        stats_count(&stats.processes_terminated, 1);
+        const DWORD push_result = handles_push(exiting, process.handle);
+        if (push_result != ERROR_SUCCESS) {
+            result = (result_t){KILL_STEAM, push_result};
             CloseHandle(process.handle);
-            return FAILURE(KILL_STEAM);
+            break;
         }
     }
 
-    return SUCCESS;
+    steam_process_iter_free(&iter);
+    return result;
+}
+
+/// terminates all Steam processes and waits until they exit, also terminating processes that spawn meanwhile.
+/// @param timeout_ms the timeout in milliseconds, or INFINITE.
+/// @param killed set to whether any process was terminated.
+/// @param exited set to whether all processes exited before the timeout.
+result_t steam_kill(steam_t const *steam, DWORD timeout_ms, uint8_t *killed, uint8_t *exited) {
+    *killed = 0;
+    *exited = 0;
+    const ULONGLONG deadline = deadline_from_timeout(timeout_ms);
+    handles_t exiting = {0};
+    result_t result;
+    for (;;) {
+        uint8_t killed_any;
+        result = steam_kill_start(steam, &exiting, &killed_any);
+        if (killed_any) *killed = 1;
+        if (result.type != OK) break;
+        if (exiting.len == 0) {
+            *exited = 1;
+            break;
+        }
+
+        // every termination is issued before waiting on any of them.
+        const DWORD wait = handles_wait_all(&exiting, deadline);
+        if (wait == WAIT_FAILED) result = FAILURE(WAIT_STEAM_EXIT);
+        handles_close(&exiting);
+        if (wait != WAIT_OBJECT_0) break;
+        // rescan, for processes that respawned before their parent was terminated (e.g. steamwebhelper).
+    }
+    handles_free(&exiting);
+    return result;
 }
 
 /// ensure username is lowercase and username_len includes NUL terminator
-result_t steam_set_auto_login_user(const char* username, uint8_t username_len) {
-    LSTATUS status = RegSetKeyValueA(
-        HKEY_CURRENT_USER,
-        "SOFTWARE\\Valve\\Steam",
+result_t steam_set_auto_login_user(steam_t const *steam, const char* username, size_t username_len) {
+    const LONG64 start = stats_start();
+    LSTATUS status = RegSetValueExA(
+        steam->key,
         "AutoLoginUser",
+        0,
         REG_SZ,
-        username,
-        username_len);
+        (const BYTE *)username,
+        (DWORD)username_len);
+    stats_time(WRITE_STEAM_REGISTRY, start);
     return (status == ERROR_SUCCESS) ? SUCCESS : (result_t){WRITE_STEAM_REGISTRY, status};
 }
 
 /// ensure username is lowercase and username_len includes NUL terminator
-result_t steam_get_auto_login_user(char* username, uint8_t *username_len) {
-    DWORD len = *username_len;
+result_t steam_get_auto_login_user(steam_t const *steam, char* username, size_t *username_len) {
+    DWORD len = (DWORD)*username_len;
+    const LONG64 start = stats_start();
     LSTATUS status = RegGetValueA(
-        HKEY_CURRENT_USER,
-        "SOFTWARE\\Valve\\Steam",
+        steam->key,
+        NULL,
         "AutoLoginUser",
         RRF_RT_REG_SZ,
         NULL,
         username,
         &len);
-    *username_len = (uint8_t)len;
-    return (status == ERROR_SUCCESS) ? SUCCESS : (result_t){WRITE_STEAM_REGISTRY, status};
+    stats_time(READ_STEAM_REGISTRY, start);
+    *username_len = len;
+    return (status == ERROR_SUCCESS) ? SUCCESS : (result_t){READ_STEAM_REGISTRY, status};
+}
+
+/// reads the account ID that Steam reports as logged in.
+/// @param active_user set to the account ID, or 0 if no account is logged in.
+result_t steam_get_active_user(steam_t const *steam, DWORD *active_user) {
+    DWORD size = sizeof(*active_user);
+    const LONG64 start = stats_start();
+    const LSTATUS status = RegGetValueW(
+        steam->key,
+        L"ActiveProcess",
+        L"ActiveUser",
+        RRF_RT_REG_DWORD,
+        NULL,
+        active_user,
+        &size
+    );
+    stats_time(READ_STEAM_REGISTRY, start);
+    if (status != ERROR_SUCCESS) *active_user = 0;
+    // Steam creates the value once it has run.
+    return (status == ERROR_SUCCESS || status == ERROR_FILE_NOT_FOUND) ? SUCCESS : (result_t){READ_STEAM_REGISTRY, status};
+}
+
+/// opens the process that Steam registers as its active process, if it's alive and runs the given Steam executable.
+/// @param key Steam's registry key.
+/// @param path the lowercase path to the Steam executable.
+/// note: close the handle after use.
+static HANDLE active_process_open(HKEY key, wchar_t const *path, size_t path_len) {
+    DWORD pid = 0;
+    DWORD size = sizeof(pid);
+    const LONG64 get_start = stats_start();
+    const LSTATUS status = RegGetValueW(
+        key,
+        L"ActiveProcess",
+        L"pid",
+        RRF_RT_REG_DWORD,
+        NULL,
+        &pid,
+        &size
+    );
+    stats_time(READ_STEAM_REGISTRY, get_start);
+    if (status != ERROR_SUCCESS || pid == 0) return NULL;
+
+    const LONG64 open_start = stats_start();
+    const HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_TERMINATE | SYNCHRONIZE, FALSE, pid);
+    stats_time(ENUM_PROCESSES, open_start);
+    if (process == NULL) return NULL;
+    stats_count(&stats.processes_opened, 1);
+    DWORD exit_code;
+    wchar_t image[MAX_PATH];
+    DWORD image_len = sizeof(image) / sizeof(wchar_t);
+    if (
+        !GetExitCodeProcess(process, &exit_code) || exit_code != STILL_ACTIVE ||
+        !QueryFullProcessImageNameW(process, 0, image, &image_len) || image_len != path_len ||
+        !steam_path_is_ancestor(image, image_len, path, path_len)
+    ) {
+        // the registered PID is stale, or was reused by another process.
+        CloseHandle(process);
+        return NULL;
+    }
+    return process;
+}
+
+/// opens the process that Steam registers as its active process, see active_process_open.
+/// note: close the handle after use.
+static HANDLE steam_active_process_open(steam_t const *steam) {
+    return active_process_open(steam->key, steam->path, steam->len);
 }
 
 result_t steam_is_running(const steam_t* steam, uint8_t *is_running) {
     *is_running = 0;
+    const HANDLE job = steam_job_open(0);
+    if (job) {
+        CloseHandle(job);
+        *is_running = 1;
+        return SUCCESS;
+    }
+    const HANDLE active = steam_active_process_open(steam);
+    if (active) {
+        CloseHandle(active);
+        *is_running = 1;
+        return SUCCESS;
+    }
+
     wchar_t dir[MAX_PATH];
     const size_t dir_len = steam_dir_lowercase(steam, dir);
 
-    steam_process_iter_t iter;
+    steam_process_iter_t iter = {0};
     DWORD iter_result = steam_process_iter_init(&iter, dir, dir_len);
-    if (iter_result != ERROR_SUCCESS) return (result_t){ENUM_PROCESSES, iter_result};
+    if (iter_result != ERROR_SUCCESS) {
+        steam_process_iter_free(&iter);
+        return (result_t){ENUM_PROCESSES, iter_result};
+    }
 
     steam_process_t process = steam_process_iter_next(&iter);
     if (process.pid) {
@@ -226,7 +781,385 @@ result_t steam_is_running(const steam_t* steam, uint8_t *is_running) {
         *is_running = 1;
     }
 
+    steam_process_iter_free(&iter);
+    return SUCCESS;
+}
+
+/// waits until all Steam processes exit, or until the timeout elapses.
+/// while Steam's registered active process is alive only it is waited on, then the remaining processes are scanned
+/// once and waited on; rescans only catch processes that spawned meanwhile.
+/// @param timeout_ms the timeout in milliseconds, or INFINITE.
+/// @param exited set to whether Steam has exited (i.e. the wait didn't time out).
+result_t steam_wait_exit(steam_t const *steam, DWORD timeout_ms, uint8_t *exited) {
+    *exited = 0;
+    const ULONGLONG deadline = deadline_from_timeout(timeout_ms);
+    wchar_t dir[MAX_PATH];
+    const size_t dir_len = steam_dir_lowercase(steam, dir);
+
+    steam_process_iter_t iter = {0};
+    handles_t set = {0};
+    result_t result = SUCCESS;
+    for (;;) {
+        const HANDLE active = steam_active_process_open(steam);
+        if (active) {
+            const LONG64 start = stats_start();
+            const DWORD wait = WaitForSingleObject(active, deadline_remaining(deadline));
+            stats_time(WAIT_STEAM_EXIT, start);
+            if (wait == WAIT_FAILED) result = FAILURE(WAIT_STEAM_EXIT);
+            CloseHandle(active);
+            if (wait != WAIT_OBJECT_0) break;
+            continue;
+        }
+
+        const DWORD iter_result = steam_process_iter_init(&iter, dir, dir_len);
+        if (iter_result != ERROR_SUCCESS) {
+            result = (result_t){ENUM_PROCESSES, iter_result};
+            break;
+        }
+        for (steam_process_t process = steam_process_iter_next(&iter); process.pid != 0; process = steam_process_iter_next(&iter)) {
+            const DWORD push_result = handles_push(&set, process.handle);
+            if (push_result != ERROR_SUCCESS) {
+                CloseHandle(process.handle);
+                result = (result_t){WAIT_STEAM_EXIT, push_result};
+                break;
+            }
+        }
+        if (result.type != OK) break;
+        if (set.len == 0) {
+            *exited = 1;
+            break;
+        }
+
+        const DWORD wait = handles_wait_all(&set, deadline);
+        if (wait == WAIT_FAILED) result = FAILURE(WAIT_STEAM_EXIT);
+        handles_close(&set);
+        if (wait != WAIT_OBJECT_0) break;
+    }
+
+    handles_free(&set);
+    steam_process_iter_free(&iter);
+    return result;
+}
+
+#ifndef REG_NOTIFY_THREAD_AGNOSTIC
+#define REG_NOTIFY_THREAD_AGNOSTIC 0x10000000L
+#endif
+
+typedef struct tracker_process_s tracker_process_t;
+
+/// keeps the set of running Steam processes current, so that checking whether Steam is running is a memory read.
+/// the set is seeded by a scan, processes leave it as their exit waits fire, and Steam's active process joins it
+/// whenever Steam registers it, which it does as it starts.
+/// processes that start without Steam registering them (e.g. games launched by a tracked process) are missed, which
+/// only matters once all of the tracked processes exit, so a scan confirms that Steam has exited once the set empties.
+/// note: start with steam_tracker_start and release with steam_tracker_free.
+typedef struct {
+    SRWLOCK lock;
+    tracker_process_t **processes;
+    size_t len;
+    size_t capacity;
+    /// whether the set has emptied since the last scan, which missed processes may have outlived.
+    uint8_t stale;
+    /// whether changes to Steam's registry key are being watched for its active process.
+    uint8_t watching;
+    /// manual-reset event that's set while the set is empty.
+    HANDLE empty;
+    /// Steam's registry key, and the auto-reset event that's signaled when it changes.
+    HKEY key;
+    HANDLE key_changed;
+    HANDLE key_wait;
+    /// lowercase path to the steam executable.
+    wchar_t path[MAX_PATH];
+    size_t path_len;
+    wchar_t dir[MAX_PATH];
+    size_t dir_len;
+} steam_tracker_t;
+
+struct tracker_process_s {
+    steam_tracker_t *tracker;
+    DWORD pid;
+    HANDLE handle;
+    /// the process' exit wait, which owns the entry once it's registered.
+    HANDLE wait;
+};
+
+static void CALLBACK tracker_process_exited(PVOID context, BOOLEAN timed_out) {
+    (void)timed_out;
+    tracker_process_t *process = context;
+    steam_tracker_t *tracker = process->tracker;
+    AcquireSRWLockExclusive(&tracker->lock);
+    size_t i = 0;
+    while (i < tracker->len && tracker->processes[i] != process) i++;
+    if (i == tracker->len) {
+        // steam_tracker_free has taken the entry, and releases it once this returns.
+        ReleaseSRWLockExclusive(&tracker->lock);
+        return;
+    }
+    tracker->processes[i] = tracker->processes[--tracker->len];
+    if (tracker->len == 0) {
+        tracker->stale = 1;
+        SetEvent(tracker->empty);
+    }
+    ReleaseSRWLockExclusive(&tracker->lock);
+    // the wait is this callback's own, so it's unregistered without waiting for the callback to return.
+    UnregisterWait(process->wait);
+    CloseHandle(process->handle);
+    free(process);
+}
+
+/// adds the process to the set, unless it's there already, taking ownership of its handle.
+/// note: hold the tracker's lock exclusively, so the exit wait can't fire before it's recorded.
+static DWORD tracker_track_locked(steam_tracker_t *tracker, DWORD pid, HANDLE handle) {
+    for (size_t i = 0; i < tracker->len; i++)
+        if (tracker->processes[i]->pid == pid) {
+            CloseHandle(handle);
+            return ERROR_SUCCESS;
+        }
+    if (tracker->len == tracker->capacity) {
+        const size_t capacity = tracker->capacity ? tracker->capacity * 2 : 64;
+        tracker_process_t **processes = realloc(tracker->processes, capacity * sizeof(tracker_process_t *));
+        if (processes == NULL) {
+            CloseHandle(handle);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        tracker->processes = processes;
+        tracker->capacity = capacity;
+    }
+    tracker_process_t *process = malloc(sizeof(tracker_process_t));
+    if (process == NULL) {
+        CloseHandle(handle);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    *process = (tracker_process_t){tracker, pid, handle, NULL};
+    if (!RegisterWaitForSingleObject(&process->wait, handle, tracker_process_exited, process, INFINITE, WT_EXECUTEONLYONCE)) {
+        const DWORD error = GetLastError();
+        CloseHandle(handle);
+        free(process);
+        return error;
+    }
+    tracker->processes[tracker->len++] = process;
+    ResetEvent(tracker->empty);
+    return ERROR_SUCCESS;
+}
+
+/// scans for Steam processes, and adds the ones that aren't in the set.
+static DWORD tracker_scan(steam_tracker_t *tracker) {
+    AcquireSRWLockExclusive(&tracker->lock);
+    tracker->stale = 0;
+    ReleaseSRWLockExclusive(&tracker->lock);
+
+    steam_process_iter_t iter = {0};
+    DWORD result = steam_process_iter_init(&iter, tracker->dir, tracker->dir_len);
+    if (result == ERROR_SUCCESS)
+        for (steam_process_t process = steam_process_iter_next(&iter); process.pid != 0; process = steam_process_iter_next(&iter)) {
+            AcquireSRWLockExclusive(&tracker->lock);
+            result = tracker_track_locked(tracker, process.pid, process.handle);
+            ReleaseSRWLockExclusive(&tracker->lock);
+            if (result != ERROR_SUCCESS) break;
+        }
+    steam_process_iter_free(&iter);
+
+    if (result != ERROR_SUCCESS) {
+        // the scan is incomplete, so the next query retries it.
+        AcquireSRWLockExclusive(&tracker->lock);
+        tracker->stale = 1;
+        ReleaseSRWLockExclusive(&tracker->lock);
+    }
+    return result;
+}
+
+static LSTATUS tracker_watch(steam_tracker_t *tracker) {
+    // thread agnostic, since the wait is re-armed by thread pool threads that don't outlive it.
+    return RegNotifyChangeKeyValue(
+        tracker->key,
+        TRUE,
+        REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_THREAD_AGNOSTIC,
+        tracker->key_changed,
+        TRUE
+    );
+}
+
+static void CALLBACK tracker_key_changed(PVOID context, BOOLEAN timed_out) {
+    (void)timed_out;
+    steam_tracker_t *tracker = context;
+    // re-armed before reading, so a change in between isn't missed.
+    const uint8_t watching = tracker_watch(tracker) == ERROR_SUCCESS;
+    const HANDLE active = active_process_open(tracker->key, tracker->path, tracker->path_len);
+    AcquireSRWLockExclusive(&tracker->lock);
+    // without notifications, queries fall back to scanning while the set is empty.
+    tracker->watching = watching;
+    if (active && tracker_track_locked(tracker, GetProcessId(active), active) != ERROR_SUCCESS) tracker->stale = 1;
+    ReleaseSRWLockExclusive(&tracker->lock);
+}
+
+void steam_tracker_free(steam_tracker_t *tracker) {
+    if (tracker == NULL) return;
+    // the waits are unregistered before anything they use is released, waiting for their callbacks to return.
+    if (tracker->key_wait) UnregisterWaitEx(tracker->key_wait, INVALID_HANDLE_VALUE);
+    AcquireSRWLockExclusive(&tracker->lock);
+    tracker_process_t **processes = tracker->processes;
+    const size_t len = tracker->len;
+    tracker->processes = NULL;
+    tracker->len = tracker->capacity = 0;
+    ReleaseSRWLockExclusive(&tracker->lock);
+    for (size_t i = 0; i < len; i++) {
+        UnregisterWaitEx(processes[i]->wait, INVALID_HANDLE_VALUE);
+        CloseHandle(processes[i]->handle);
+        free(processes[i]);
+    }
+    free(processes);
+    if (tracker->key) RegCloseKey(tracker->key);
+    if (tracker->key_changed) CloseHandle(tracker->key_changed);
+    if (tracker->empty) CloseHandle(tracker->empty);
+    free(tracker);
+}
+
+/// starts tracking Steam's processes, see steam_tracker_t.
+/// the tracker is independent of the steam, which may be freed before it.
+/// @param tracker set to the tracker, or NULL on failure.
+result_t steam_tracker_start(steam_t const *steam, steam_tracker_t **tracker) {
+    *tracker = calloc(1, sizeof(steam_tracker_t));
+    steam_tracker_t *t = *tracker;
+    if (t == NULL) return (result_t){ENUM_PROCESSES, ERROR_NOT_ENOUGH_MEMORY};
+    InitializeSRWLock(&t->lock);
+    memcpy(t->path, steam->path, sizeof(t->path));
+    t->path_len = steam->len;
+    t->dir_len = steam_dir_lowercase(steam, t->dir);
+
+    result_t result = SUCCESS;
+    t->empty = CreateEventW(NULL, TRUE, TRUE, NULL);
+    t->key_changed = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (t->empty == NULL || t->key_changed == NULL) {
+        result = FAILURE(ENUM_PROCESSES);
+        goto fail;
+    }
+    const LSTATUS open_status = RegOpenKeyExW(HKEY_CURRENT_USER, STEAM_KEY, 0, KEY_QUERY_VALUE | KEY_NOTIFY, &t->key);
+    if (open_status != ERROR_SUCCESS) {
+        t->key = NULL;
+        result = (result_t){READ_STEAM_REGISTRY, (DWORD)open_status};
+        goto fail;
+    }
+    // watched before the scan, so a Steam that starts in between isn't missed.
+    const LSTATUS watch_status = tracker_watch(t);
+    if (watch_status != ERROR_SUCCESS) {
+        result = (result_t){ENUM_PROCESSES, (DWORD)watch_status};
+        goto fail;
+    }
+    t->watching = 1;
+    if (!RegisterWaitForSingleObject(&t->key_wait, t->key_changed, tracker_key_changed, t, INFINITE, WT_EXECUTEDEFAULT)) {
+        t->key_wait = NULL;
+        result = FAILURE(ENUM_PROCESSES);
+        goto fail;
+    }
+    const DWORD scan_result = tracker_scan(t);
+    if (scan_result != ERROR_SUCCESS) {
+        result = (result_t){ENUM_PROCESSES, scan_result};
+        goto fail;
+    }
     return SUCCESS;
+
+    fail:
+    steam_tracker_free(t);
+    *tracker = NULL;
+    return result;
+}
+
+/// checks whether any Steam process is running, scanning only when the set has emptied since the last scan.
+result_t steam_tracker_is_running(steam_tracker_t *tracker, uint8_t *is_running) {
+    AcquireSRWLockShared(&tracker->lock);
+    *is_running = tracker->len != 0;
+    const uint8_t scan = !*is_running && (tracker->stale || !tracker->watching);
+    ReleaseSRWLockShared(&tracker->lock);
+    if (!scan) return SUCCESS;
+
+    const DWORD scan_result = tracker_scan(tracker);
+    if (scan_result != ERROR_SUCCESS) return (result_t){ENUM_PROCESSES, scan_result};
+    AcquireSRWLockShared(&tracker->lock);
+    *is_running = tracker->len != 0;
+    ReleaseSRWLockShared(&tracker->lock);
+    return SUCCESS;
+}
+
+/// waits until all Steam processes exit, or until the timeout elapses, without rescanning while any is tracked.
+/// @param timeout_ms the timeout in milliseconds, or INFINITE.
+/// @param exited set to whether Steam has exited (i.e. the wait didn't time out).
+result_t steam_tracker_wait_exit(steam_tracker_t *tracker, DWORD timeout_ms, uint8_t *exited) {
+    *exited = 0;
+    const ULONGLONG deadline = deadline_from_timeout(timeout_ms);
+    for (;;) {
+        const LONG64 start = stats_start();
+        const DWORD wait = WaitForSingleObject(tracker->empty, deadline_remaining(deadline));
+        stats_time(WAIT_STEAM_EXIT, start);
+        if (wait == WAIT_FAILED) return FAILURE(WAIT_STEAM_EXIT);
+        if (wait != WAIT_OBJECT_0) return SUCCESS;
+        uint8_t is_running;
+        const result_t running_result = steam_tracker_is_running(tracker, &is_running);
+        if (running_result.type != OK) return running_result;
+        if (!is_running) {
+            *exited = 1;
+            return SUCCESS;
+        }
+    }
+}
+
+/// copies the PIDs of the tracked processes, up to the capacity.
+/// @return the number of tracked processes, which may exceed the capacity.
+size_t steam_tracker_pids(steam_tracker_t *tracker, DWORD *pids, size_t capacity) {
+    AcquireSRWLockShared(&tracker->lock);
+    const size_t len = tracker->len;
+    for (size_t i = 0; i < len && i < capacity; i++) pids[i] = tracker->processes[i]->pid;
+    ReleaseSRWLockShared(&tracker->lock);
+    return len;
+}
+
+/// waits until Steam reports a logged in user in its ActiveProcess key, or until the timeout elapses.
+/// @param account_id the account ID (the low 32 bits of the SteamID64) to wait for, or 0 for any.
+/// @param timeout_ms the timeout in milliseconds, or INFINITE.
+/// @param active_user set to the logged in account ID, or 0 if the wait timed out.
+result_t steam_wait_login(steam_t const *steam, DWORD account_id, DWORD timeout_ms, DWORD *active_user) {
+    *active_user = 0;
+    const ULONGLONG deadline = deadline_from_timeout(timeout_ms);
+    HKEY key;
+    const LSTATUS open_status = RegOpenKeyExW(
+        steam->key,
+        L"ActiveProcess",
+        0,
+        KEY_QUERY_VALUE | KEY_NOTIFY,
+        &key
+    );
+    if (open_status != ERROR_SUCCESS) return (result_t){READ_STEAM_REGISTRY, open_status};
+    const HANDLE changed = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (changed == NULL) {
+        const result_t failure = FAILURE(WAIT_STEAM_LOGIN);
+        RegCloseKey(key);
+        return failure;
+    }
+
+    result_t result = SUCCESS;
+    for (;;) {
+        // subscribe before reading, so a change in between isn't missed.
+        const LSTATUS notify_status = RegNotifyChangeKeyValue(key, FALSE, REG_NOTIFY_CHANGE_LAST_SET, changed, TRUE);
+        if (notify_status != ERROR_SUCCESS) {
+            result = (result_t){WAIT_STEAM_LOGIN, (DWORD)notify_status};
+            break;
+        }
+        DWORD user = 0;
+        DWORD size = sizeof(user);
+        if (RegGetValueW(key, NULL, L"ActiveUser", RRF_RT_REG_DWORD, NULL, &user, &size) != ERROR_SUCCESS) user = 0;
+        if (user != 0 && (account_id == 0 || user == account_id)) {
+            *active_user = user;
+            break;
+        }
+        const LONG64 start = stats_start();
+        const DWORD wait = WaitForSingleObject(changed, deadline_remaining(deadline));
+        stats_time(WAIT_STEAM_LOGIN, start);
+        if (wait == WAIT_FAILED) result = FAILURE(WAIT_STEAM_LOGIN);
+        if (wait != WAIT_OBJECT_0) break;
+    }
+
+    CloseHandle(changed);
+    RegCloseKey(key);
+    return result;
 }
 
 result_t steam_vdf_loginusers(const steam_t *steam, HANDLE* file) {
@@ -234,6 +1167,7 @@ result_t steam_vdf_loginusers(const steam_t *steam, HANDLE* file) {
     const size_t dir_len = steam_dir_lowercase(steam, path);
     static wchar_t subpath[] = L"config\\loginusers.vdf";
     memcpy(&path[dir_len], subpath, sizeof(subpath));
+    const LONG64 start = stats_start();
     *file = CreateFileW(
         path,
         GENERIC_READ,
@@ -243,5 +1177,401 @@ result_t steam_vdf_loginusers(const steam_t *steam, HANDLE* file) {
         FILE_ATTRIBUTE_NORMAL,
         NULL
     );
+    stats_time(OPEN_VDF, start);
     return *file != INVALID_HANDLE_VALUE ? SUCCESS : FAILURE(OPEN_VDF);
-}
\ No newline at end of file
+}
+
+/// identifies a version of a file: writing to or replacing the file changes it.
+typedef struct {
+    uint64_t size;
+    /// the last write time, as a FILETIME.
+    uint64_t write_time;
+    /// the file's index on its volume.
+    uint64_t index;
+    /// the serial number of the file's volume.
+    uint32_t volume;
+} file_identity_t;
+
+result_t steam_file_identity(HANDLE file, file_identity_t *identity) {
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(file, &info)) return FAILURE(READ_VDF);
+    *identity = (file_identity_t){
+        .size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow,
+        .write_time = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime,
+        .index = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow,
+        .volume = info.dwVolumeSerialNumber,
+    };
+    return SUCCESS;
+}
+/// resolves a path relative to the Steam directory.
+/// @return ERROR_SUCCESS, or ERROR_FILENAME_EXCED_RANGE if the path doesn't fit.
+static DWORD steam_subpath(steam_t const *steam, const wchar_t *subpath, wchar_t out[MAX_PATH]) {
+    const size_t dir_len = steam_dir_lowercase(steam, out);
+    const size_t subpath_len = wcslen(subpath);
+    if (dir_len + subpath_len >= MAX_PATH) return ERROR_FILENAME_EXCED_RANGE;
+    memcpy(&out[dir_len], subpath, (subpath_len + /* NUL */ 1) * sizeof(wchar_t));
+    return ERROR_SUCCESS;
+}
+
+/// watches a directory for changes to its files.
+/// note: start with steam_watch_start and release with steam_watch_free.
+typedef struct {
+    HANDLE dir;
+    OVERLAPPED overlapped;
+    /// whether a read of changes is in flight. once one is issued, the system queues changes between reads.
+    uint8_t pending;
+    /// FILE_NOTIFY_INFORMATION records, which are DWORD-aligned.
+    DWORD buffer[1024];
+} steam_watch_t;
+
+/// issues a read of changes, completing once there are some.
+static BOOL watch_read(steam_watch_t *watch) {
+    ResetEvent(watch->overlapped.hEvent);
+    watch->pending = ReadDirectoryChangesW(
+        watch->dir,
+        watch->buffer,
+        sizeof(watch->buffer),
+        FALSE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+        NULL,
+        &watch->overlapped,
+        NULL
+    ) != 0;
+    return watch->pending;
+}
+
+void steam_watch_free(steam_watch_t *watch) {
+    if (watch == NULL) return;
+    if (watch->pending) {
+        // the read writes to the buffer, so it's waited for before the buffer is released.
+        DWORD bytes;
+        CancelIoEx(watch->dir, &watch->overlapped);
+        GetOverlappedResult(watch->dir, &watch->overlapped, &bytes, TRUE);
+    }
+    if (watch->dir != INVALID_HANDLE_VALUE) CloseHandle(watch->dir);
+    if (watch->overlapped.hEvent) CloseHandle(watch->overlapped.hEvent);
+    free(watch);
+}
+
+/// starts watching a directory in the Steam directory.
+/// @param subdir the directory, relative to the Steam directory, e.g. L"config".
+/// @param watch set to the watch, or NULL on failure.
+result_t steam_watch_start(steam_t const *steam, const wchar_t *subdir, steam_watch_t **watch) {
+    *watch = NULL;
+    wchar_t path[MAX_PATH];
+    const DWORD path_result = steam_subpath(steam, subdir, path);
+    if (path_result != ERROR_SUCCESS) return (result_t){WATCH, path_result};
+    steam_watch_t *w = calloc(1, sizeof(steam_watch_t));
+    if (w == NULL) return (result_t){WATCH, ERROR_NOT_ENOUGH_MEMORY};
+    w->dir = CreateFileW(
+        path,
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        NULL
+    );
+    w->overlapped.hEvent = w->dir == INVALID_HANDLE_VALUE ? NULL : CreateEventW(NULL, TRUE, FALSE, NULL);
+    // read right away, so that changes are queued from now on.
+    if (w->overlapped.hEvent == NULL || !watch_read(w)) {
+        const result_t failure = FAILURE(WATCH);
+        steam_watch_free(w);
+        return failure;
+    }
+    *watch = w;
+    return SUCCESS;
+}
+
+/// waits until a file in the watched directory changes, or until the timeout elapses.
+/// @param name the file's name, e.g. L"loginusers.vdf".
+/// @param timeout_ms the timeout in milliseconds, or INFINITE.
+/// @param changed set to whether the file may have changed, which is also the case when so many files changed that
+///                the system dropped the changes.
+result_t steam_watch_wait(steam_watch_t *watch, const wchar_t *name, DWORD timeout_ms, uint8_t *changed) {
+    *changed = 0;
+    const ULONGLONG deadline = deadline_from_timeout(timeout_ms);
+    const size_t name_len = wcslen(name);
+    while (!*changed) {
+        if (!watch->pending && !watch_read(watch)) return FAILURE(WATCH);
+        const DWORD wait = WaitForSingleObject(watch->overlapped.hEvent, deadline_remaining(deadline));
+        if (wait == WAIT_FAILED) return FAILURE(WATCH);
+        if (wait != WAIT_OBJECT_0) break;
+
+        watch->pending = 0;
+        DWORD bytes;
+        if (!GetOverlappedResult(watch->dir, &watch->overlapped, &bytes, FALSE)) {
+            if (GetLastError() != ERROR_NOTIFY_ENUM_DIR) return FAILURE(WATCH);
+            bytes = 0;
+        }
+        if (bytes == 0) {
+            // the changes overflowed the buffer and were dropped.
+            *changed = 1;
+            break;
+        }
+        for (FILE_NOTIFY_INFORMATION const *info = (FILE_NOTIFY_INFORMATION const *)watch->buffer;;) {
+            if (
+                info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME &&
+                info->FileNameLength / sizeof(WCHAR) == name_len && _wcsnicmp(info->FileName, name, name_len) == 0
+            ) *changed = 1;
+            if (info->NextEntryOffset == 0) break;
+            info = (FILE_NOTIFY_INFORMATION const *)((BYTE const *)info + info->NextEntryOffset);
+        }
+    }
+    return SUCCESS;
+}
+
+/// a read-only view of a file's contents.
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    /// whether data is a mapped view of the file, rather than a buffer it was read into.
+    uint8_t mapped;
+} steam_view_t;
+
+/// maps a file in the Steam directory into memory, falling back to reading it sequentially.
+/// @param subpath the file's path, relative to the Steam directory.
+/// note: release the view with steam_view_free after use.
+result_t steam_file_map(steam_t const *steam, const wchar_t *subpath, steam_view_t *view) {
+    *view = (steam_view_t){(const uint8_t *)"", 0, 0};
+    wchar_t path[MAX_PATH];
+    const DWORD path_result = steam_subpath(steam, subpath, path);
+    if (path_result != ERROR_SUCCESS) return (result_t){OPEN_VDF, path_result};
+    const LONG64 open_start = stats_start();
+    const HANDLE file = CreateFileW(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL
+    );
+    stats_time(OPEN_VDF, open_start);
+    if (file == INVALID_HANDLE_VALUE) return FAILURE(OPEN_VDF);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        const result_t failure = FAILURE(READ_VDF);
+        CloseHandle(file);
+        return failure;
+    }
+    if (size.QuadPart == 0) { // empty files can't be mapped
+        CloseHandle(file);
+        return SUCCESS;
+    }
+
+    // the view keeps the mapping (and the file) alive, so the handles can be closed right away.
+    const LONG64 map_start = stats_start();
+    const HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+        const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        stats_time(READ_VDF, map_start);
+        CloseHandle(mapping);
+        if (data) {
+            CloseHandle(file);
+            *view = (steam_view_t){data, (size_t)size.QuadPart, 1};
+            return SUCCESS;
+        }
+    }
+
+    uint8_t *buffer = malloc((size_t)size.QuadPart);
+    if (buffer == NULL) {
+        CloseHandle(file);
+        return (result_t){READ_VDF, ERROR_NOT_ENOUGH_MEMORY};
+    }
+    size_t read = 0;
+    while (read < (size_t)size.QuadPart) {
+        const size_t left = (size_t)size.QuadPart - read;
+        DWORD chunk = 0;
+        const LONG64 read_start = stats_start();
+        const BOOL chunk_read = ReadFile(file, buffer + read, left < 0x40000000 ? (DWORD)left : 0x40000000, &chunk, NULL);
+        stats_time(READ_VDF, read_start);
+        if (!chunk_read) {
+            const result_t failure = FAILURE(READ_VDF);
+            free(buffer);
+            CloseHandle(file);
+            return failure;
+        }
+        if (chunk == 0) break; // the file shrank
+        read += chunk;
+    }
+    CloseHandle(file);
+    if (read == 0) free(buffer);
+    else *view = (steam_view_t){buffer, read, 0};
+    return SUCCESS;
+}
+
+void steam_view_free(steam_view_t *view) {
+    if (view->mapped) UnmapViewOfFile(view->data);
+    else if (view->len) free((void *)view->data);
+    *view = (steam_view_t){(const uint8_t *)"", 0, 0};
+}
+
+/// replaces a file in the Steam directory with the given contents, atomically.
+/// the contents are written to a temporary file next to it, which then replaces it.
+/// @param subpath the file's path, relative to the Steam directory.
+result_t steam_file_replace(steam_t const *steam, const wchar_t *subpath, const uint8_t *data, size_t len) {
+    wchar_t path[MAX_PATH];
+    const DWORD path_result = steam_subpath(steam, subpath, path);
+    if (path_result != ERROR_SUCCESS) return (result_t){WRITE_VDF, path_result};
+    static const wchar_t temp_suffix[] = L".diverter";
+    wchar_t temp_path[MAX_PATH];
+    const size_t path_len = wcslen(path);
+    if (path_len + sizeof(temp_suffix) / sizeof(wchar_t) > MAX_PATH)
+        return (result_t){WRITE_VDF, ERROR_FILENAME_EXCED_RANGE};
+    memcpy(temp_path, path, path_len * sizeof(wchar_t));
+    memcpy(&temp_path[path_len], temp_suffix, sizeof(temp_suffix));
+
+    const HANDLE file = CreateFileW(
+        temp_path,
+        GENERIC_WRITE,
+        0,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (file == INVALID_HANDLE_VALUE) return FAILURE(WRITE_VDF);
+    const LONG64 write_start = stats_start();
+    size_t written = 0;
+    while (written < len) {
+        const size_t left = len - written;
+        DWORD chunk = 0;
+        if (!WriteFile(file, data + written, left < 0x40000000 ? (DWORD)left : 0x40000000, &chunk, NULL)) break;
+        if (chunk == 0) {
+            // a write that succeeds without writing sets no error of its own.
+            SetLastError(ERROR_WRITE_FAULT);
+            break;
+        }
+        written += chunk;
+    }
+    // flushed so that a crash can't replace the file with a partially written one.
+    const BOOL flushed = written == len && FlushFileBuffers(file);
+    stats_time(WRITE_VDF, write_start);
+    if (!flushed) {
+        const result_t failure = FAILURE(WRITE_VDF);
+        CloseHandle(file);
+        DeleteFileW(temp_path);
+        return failure;
+    }
+    CloseHandle(file);
+
+    const LONG64 replace_start = stats_start();
+    const BOOL replaced = ReplaceFileW(path, temp_path, NULL, REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL);
+    stats_time(WRITE_VDF, replace_start);
+    if (!replaced) {
+        const result_t failure = FAILURE(WRITE_VDF);
+        DeleteFileW(temp_path);
+        return failure;
+    }
+    return SUCCESS;
+}
+
+#define DIVERTER_PIPE_NAME L"\\\\.\\pipe\\diverter"
+#define DIVERTER_PIPE_BUFFER_SIZE 4096
+
+/// a buffer for a TOKEN_USER, which is followed by the SID it points to.
+typedef union {
+    TOKEN_USER user;
+    BYTE bytes[sizeof(TOKEN_USER) + SECURITY_MAX_SID_SIZE];
+} token_user_t;
+
+/// gets the user a process runs as.
+/// note: the process needs to be opened with PROCESS_QUERY_LIMITED_INFORMATION access.
+static BOOL process_user(HANDLE process, token_user_t *user) {
+    HANDLE token;
+    if (!OpenProcessToken(process, TOKEN_QUERY, &token)) return FALSE;
+    DWORD size;
+    const BOOL got = GetTokenInformation(token, TokenUser, user, sizeof(*user), &size);
+    const DWORD error = GetLastError();
+    CloseHandle(token);
+    SetLastError(error);
+    return got;
+}
+
+/// creates the daemon's pipe, failing with ERROR_ACCESS_DENIED if another daemon has it.
+/// only the current user (and the system) may connect to it, since the daemon runs the commands it gets as the user.
+/// note: close the pipe with CloseHandle after use.
+result_t steam_pipe_create(HANDLE *pipe) {
+    *pipe = INVALID_HANDLE_VALUE;
+    token_user_t user;
+    if (!process_user(GetCurrentProcess(), &user)) return FAILURE(PIPE);
+    wchar_t *sid;
+    if (!ConvertSidToStringSidW(user.user.User.Sid, &sid)) return FAILURE(PIPE);
+    // a protected DACL that grants all access to the system and the user, and none to anyone else.
+    wchar_t sddl[64 + SECURITY_MAX_SID_STRING_CHARACTERS];
+    const int sddl_len = swprintf(sddl, sizeof(sddl) / sizeof(*sddl), L"D:P(A;;GA;;;SY)(A;;GA;;;%ls)", sid);
+    LocalFree(sid);
+    if (sddl_len < 0) return (result_t){PIPE, ERROR_INSUFFICIENT_BUFFER};
+    SECURITY_ATTRIBUTES security = { .nLength = sizeof(security), .lpSecurityDescriptor = NULL, .bInheritHandle = FALSE };
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl, SDDL_REVISION_1, &security.lpSecurityDescriptor, NULL))
+        return FAILURE(PIPE);
+    *pipe = CreateNamedPipeW(
+        DIVERTER_PIPE_NAME,
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        1,
+        DIVERTER_PIPE_BUFFER_SIZE,
+        DIVERTER_PIPE_BUFFER_SIZE,
+        0,
+        &security
+    );
+    const result_t result = *pipe != INVALID_HANDLE_VALUE ? SUCCESS : FAILURE(PIPE);
+    LocalFree(security.lpSecurityDescriptor);
+    return result;
+}
+
+/// checks that the pipe's server runs as the current user, so that another user can't pose as the daemon by
+/// creating its pipe first, failing with ERROR_ACCESS_DENIED if it doesn't.
+static result_t pipe_verify_server(HANDLE pipe) {
+    ULONG server_id;
+    if (!GetNamedPipeServerProcessId(pipe, &server_id)) return FAILURE(PIPE);
+    token_user_t current, server;
+    if (!process_user(GetCurrentProcess(), &current)) return FAILURE(PIPE);
+    // another user's process usually can't be opened at all, which is just as telling.
+    const HANDLE server_process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, server_id);
+    if (server_process == NULL) return (result_t){PIPE, ERROR_ACCESS_DENIED};
+    const BOOL got = process_user(server_process, &server);
+    CloseHandle(server_process);
+    if (!got || !EqualSid(current.user.User.Sid, server.user.User.Sid)) return (result_t){PIPE, ERROR_ACCESS_DENIED};
+    return SUCCESS;
+}
+
+/// waits for a client to connect to the daemon's pipe.
+result_t steam_pipe_accept(HANDLE pipe) {
+    // a client may connect between creation and this call, which is just as good.
+    return ConnectNamedPipe(pipe, NULL) || GetLastError() == ERROR_PIPE_CONNECTED ? SUCCESS : FAILURE(PIPE);
+}
+
+/// disconnects the current client from the daemon's pipe, once it has read everything.
+void steam_pipe_disconnect(HANDLE pipe) {
+    FlushFileBuffers(pipe);
+    DisconnectNamedPipe(pipe);
+}
+
+/// connects to the daemon's pipe, waiting up to timeout_ms while the daemon serves another client.
+/// @param pipe receives the connection, or INVALID_HANDLE_VALUE if no daemon is running.
+/// note: close the connection with CloseHandle after use.
+result_t steam_pipe_connect(HANDLE *pipe, DWORD timeout_ms) {
+    const ULONGLONG deadline = deadline_from_timeout(timeout_ms);
+    for (;;) {
+        *pipe = CreateFileW(DIVERTER_PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (*pipe != INVALID_HANDLE_VALUE) {
+            const result_t verified = pipe_verify_server(*pipe);
+            if (verified.type != OK) {
+                CloseHandle(*pipe);
+                *pipe = INVALID_HANDLE_VALUE;
+            }
+            return verified;
+        }
+        const DWORD error = GetLastError();
+        if (error == ERROR_FILE_NOT_FOUND) return SUCCESS;
+        if (error != ERROR_PIPE_BUSY) return (result_t){PIPE, error};
+        const DWORD remaining = deadline_remaining(deadline);
+        if (remaining == 0) return (result_t){PIPE, ERROR_SEM_TIMEOUT};
+        // the daemon might exit meanwhile, which the next attempt finds out.
+        if (!WaitNamedPipeW(DIVERTER_PIPE_NAME, remaining) && GetLastError() != ERROR_FILE_NOT_FOUND)
+            return FAILURE(PIPE);
+    }
+}